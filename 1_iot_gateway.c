@@ -1,39 +1,399 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <unistd.h>
 
-#define MAX_LOGS 20
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-typedef struct SensorLog {
+#define DEFAULT_MAX_LOGS 20
+#define INGEST_QUEUE_SIZE 4096 // must be a power of two
+#define INGEST_BATCH 256
+#define DEFAULT_STRESS_SECONDS 5
+#define DEFAULT_REPLAY_BATCH 256
+#define CAPTURE_INITIAL 4096
+#define DEFAULT_HISTORY_CAPACITY 100000
+#define SESSION_FILE "session_state.bin"
+#define LEGACY_SESSION_FILE "session_state.txt"
+#define SESSION_MAGIC 0x47544f49 // "IOTG"
+#define SESSION_VERSION 3
+#define SEGMENT_BLOCK_RECORDS 64
+#define SEGMENT_COMPACT_FACTOR 4
+#define ROLLUP_BLOCK_BUCKETS 16 // fits the DiskRecord block buffer of append_block
+#define DEFAULT_FSYNC_INTERVAL_MS 100
+#define DEFAULT_FSYNC_BATCH 256
+#define SENSOR_INDEX_INITIAL 64 // hash slots; must be a power of two
+#define RANGE_DISPLAY_LIMIT 10
+#define DEFAULT_SAMPLE_INTERVAL_US 2000000
+#define ECHO_SAMPLE_INTERVAL_US 100000 // print each reading at or above this
+#define MAX_SAMPLES_PER_TICK 1024
+#define COMMAND_BUFFER 512
+#define DEFAULT_ROLLUP_BUCKETS 50000
+#define HISTORY_BLOCK 1024
+#define MAX_ENCODED_READING 48 // worst-case bytes per reading across all streams
+
+typedef struct {
   int sensor_id;
   float temperature;
   float humidity;
   float pressure;
   float vibration;
   time_t timestamp;
-  struct SensorLog *next;
-  struct SensorLog *prev;
 } SensorLog;
 
+// Fixed-capacity ring buffer: records[] is allocated once in init_log_system
+// and reused, so steady-state ingest never allocates. `start` is the slot of
+// the oldest reading and `current` is a logical position (0 = oldest).
+// Every reading also gets an absolute sequence number; `first_seq` is the
+// sequence of the oldest one, so position = seq - first_seq.
 typedef struct {
-  SensorLog *head;
-  SensorLog *tail;
-  SensorLog *current;
+  SensorLog *records;
+  int capacity;
+  int start;
   int count;
-  int live_mode;
+  int current;
+  int live_mode; // only touched by the event loop thread
+  unsigned long first_seq;
   pthread_mutex_t log_mutex;
 } LogSystem;
 
-LogSystem log_system = {NULL, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+LogSystem log_system = {NULL, 0, 0, 0, -1, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+// Per-sensor index over the ring: the sequence numbers of one sensor's
+// readings, oldest first. Eviction is global-oldest-first, so it only ever
+// pops the head of one list.
+typedef struct {
+  int sensor_id;
+  int used;
+  unsigned long *seqs;
+  int head;
+  int count;
+  int capacity;
+} SensorIndex;
+
+// Open-addressing map from sensor_id to its SensorIndex.
+typedef struct {
+  SensorIndex *slots;
+  int size;
+  int used;
+} SensorIndexMap;
+
+SensorIndexMap sensor_index = {NULL, 0, 0};
+
+// Single-threaded UI/sampling loop: stdin commands, a timerfd that drives
+// live sampling, and an eventfd that SIGINT/SIGTERM use to request a clean
+// shutdown.
+typedef struct {
+  int epoll_fd;
+  int timer_fd;
+  int shutdown_fd;
+  int stdin_is_file; // epoll cannot watch regular files
+  long sample_interval_us;
+  int next_sensor_id;
+  int running;
+  char line[COMMAND_BUFFER];
+  size_t line_length;
+} EventLoop;
+
+EventLoop event_loop = {-1, -1, -1, 0, DEFAULT_SAMPLE_INTERVAL_US, 1, 0, {0}, 0};
+
+enum {
+  METRIC_TEMPERATURE,
+  METRIC_HUMIDITY,
+  METRIC_PRESSURE,
+  METRIC_VIBRATION,
+  METRIC_COUNT
+};
+
+const char *metric_names[METRIC_COUNT] = {"Temperature", "Humidity",
+                                          "Pressure", "Vibration"};
+
+// One block of readings in columnar (struct-of-arrays) layout, so
+// aggregate queries scan contiguous floats.
+typedef struct {
+  float columns[METRIC_COUNT][HISTORY_BLOCK];
+  time_t timestamps[HISTORY_BLOCK];
+  int sensor_ids[HISTORY_BLOCK];
+  int count;
+} HistoryColumns;
+
+// Streams in a sealed block: one per metric, then timestamps and sensor ids.
+enum { STREAM_TIMESTAMP = METRIC_COUNT, STREAM_SENSOR, STREAM_COUNT };
+
+// A full block encoded Gorilla-style: delta-of-delta timestamps and
+// XOR-compressed floats, each column in its own bit stream at
+// data + offsets[stream].
+typedef struct {
+  int count;
+  time_t first_timestamp;
+  time_t last_timestamp;
+  uint32_t offsets[STREAM_COUNT + 1];
+  unsigned char *data;
+} SealedBlock;
+
+// Raw retention tier, kept next to the navigation ring. New readings fill
+// the open block; a full block is compressed and pushed onto a ring of
+// sealed blocks. Readings leave a whole sealed block at a time, when the
+// ring is full or, with a raw window set, once the block is older than the
+// window, and are folded into rollups. Appended in arrival order under
+// log_mutex.
+typedef struct {
+  HistoryColumns *open;
+  HistoryColumns *scratch; // decode buffer for queries and eviction
+  SealedBlock *sealed;
+  int sealed_capacity;
+  int sealed_start;
+  int sealed_count;
+  int capacity; // requested readings; retention is rounded up to whole blocks
+  int count;
+  size_t compressed_bytes;
+  time_t raw_window; // seconds of raw history to keep; 0 = capacity only
+} HistoryStore;
+
+HistoryStore history;
+
+typedef struct {
+  unsigned char *data;
+  size_t size;
+  int bit; // bits used in data[size - 1]; 8 means start a new byte
+} BitWriter;
+
+typedef struct {
+  const unsigned char *data;
+  size_t position; // in bits
+} BitReader;
+
+// Per-sensor summary of every reading in [start, start + granularity).
+typedef struct {
+  int sensor_id;
+  time_t start;
+  int count;
+  float min[METRIC_COUNT];
+  float max[METRIC_COUNT];
+  double sum[METRIC_COUNT];
+  double sum_sq[METRIC_COUNT];
+} RollupBucket;
+
+// Open-addressing map from sensor_id to the sequence number of that
+// sensor's newest bucket in a tier (stored +1 so 0 means none).
+typedef struct {
+  int *keys;
+  unsigned long *values;
+  int size;
+  int used;
+} SensorSlotMap;
+
+// A bounded ring of rollup buckets in creation (= time) order. Buckets are
+// created and merged incrementally as the tier below evicts, so nothing is
+// ever recomputed; evictions from this tier feed `next`, or are dropped
+// from the coarsest tier.
+typedef struct RollupTier {
+  const char *name;
+  int granularity;
+  RollupBucket *buckets;
+  int capacity;
+  int start;
+  int count;
+  unsigned long first_seq;
+  SensorSlotMap newest;
+  struct RollupTier *next;
+} RollupTier;
+
+RollupTier hour_tier = {"hour", 3600, NULL, DEFAULT_ROLLUP_BUCKETS, 0, 0, 0,
+                        {NULL, NULL, 0, 0}, NULL};
+RollupTier minute_tier = {"minute", 60, NULL, DEFAULT_ROLLUP_BUCKETS, 0, 0, 0,
+                          {NULL, NULL, 0, 0}, &hour_tier};
+
+typedef struct {
+  int count;
+  float min;
+  float max;
+  double sum;
+  double sum_sq;
+} Aggregate;
+
+// Bounded lock-free MPSC queue (Vyukov's sequence-numbered ring). Producers
+// claim a slot with a CAS on enqueue_pos and never touch log_mutex; the
+// single ingest consumer drains slots in order into log_system.
+typedef struct {
+  unsigned long sequence;
+  SensorLog log;
+} IngestSlot;
+
+typedef struct {
+  IngestSlot slots[INGEST_QUEUE_SIZE];
+  char pad0[64];
+  unsigned long enqueue_pos;
+  char pad1[64];
+  unsigned long dequeue_pos;
+  unsigned long consumed;
+  unsigned long dropped;
+  int running;
+  pthread_t consumer;
+} IngestQueue;
+
+IngestQueue ingest_queue;
+
+// Session segment layout: one SegmentHeader, then any number of blocks,
+// each a BlockHeader followed by its payload: `count` packed DiskRecords
+// for a data block, one CheckpointRecord, or `count` DiskRollups for a
+// rollup block. The segment is also the
+// write-ahead journal: blocks are only ever appended, and a torn or
+// corrupt block ends the segment on load.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t block_records;
+  int32_t current_from_end; // version 1 only; later versions use checkpoints
+} SegmentHeader;
+
+enum { BLOCK_DATA = 0, BLOCK_CHECKPOINT = 1, BLOCK_ROLLUP = 2 };
+
+typedef struct {
+  uint16_t count; // readings in a data block, buckets in a rollup block
+  uint16_t type;  // always BLOCK_DATA in version 1 segments
+  uint32_t crc;   // CRC-32 of the payload that follows
+} BlockHeader;
+
+typedef struct {
+  int64_t timestamp;
+  int32_t sensor_id;
+  float temperature;
+  float humidity;
+  float pressure;
+  float vibration;
+  uint32_t reserved;
+} DiskRecord;
+
+// Written on clean shutdown and after compaction. Everything after the
+// last checkpoint is replayed as crash recovery.
+typedef struct {
+  int32_t current_from_end; // 1 = newest reading, 0 = no position saved
+  uint32_t reserved;
+} CheckpointRecord;
+
+// A sealed rollup bucket. Compaction drops readings that only survive as
+// rollups, so it writes both tiers in their place (hour tier first, each
+// oldest first); a run of rollup blocks replaces the tiers on load and
+// stands for every reading before it.
+typedef struct {
+  int64_t start;
+  int32_t sensor_id;
+  int32_t count;
+  int32_t granularity; // seconds: selects the tier
+  uint32_t reserved;
+  float min[METRIC_COUNT];
+  float max[METRIC_COUNT];
+  double sum[METRIC_COUNT];
+  double sum_sq[METRIC_COUNT];
+} DiskRollup;
+
+// Group-commit journal writer. add_logs_to_system only copies readings
+// into `pending`; the writer thread swaps buffers, appends every pending
+// reading with one write() and issues one fdatasync per batch.
+typedef struct {
+  int fd;
+  DiskRecord *pending;
+  DiskRecord *writing;
+  int pending_count;
+  int pending_capacity;
+  int writing_capacity;
+  unsigned char *scratch;
+  size_t scratch_size;
+  int batch_size;
+  int fsync_interval_ms;
+  int running;
+  int truncate_requested;
+  unsigned long commits;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  pthread_t writer;
+} Journal;
+
+Journal journal = {-1, NULL, NULL, 0, 0, 0, NULL, 0, DEFAULT_FSYNC_BATCH,
+                   DEFAULT_FSYNC_INTERVAL_MS, 0, 0, 0,
+                   PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
 
 
-void init_log_system();
+void init_log_system(int capacity, int history_capacity);
 void cleanup_log_system();
-SensorLog *create_sensor_log(int sensor_id, float temp, float humidity,
-                             float pressure, float vibration);
-void add_log_to_system(SensorLog *log);
+SensorLog create_sensor_log(int sensor_id, float temp, float humidity,
+                            float pressure, float vibration);
+void add_log_to_system(const SensorLog *log);
+void add_logs_to_system(const SensorLog *logs, int count);
+void store_log(const SensorLog *log);
+void append_history(const SensorLog *log);
+void evict_history_oldest();
+unsigned long *sensor_slot(SensorSlotMap *map, int sensor_id);
+int init_rollup_tier(RollupTier *tier);
+void free_rollup_tier(RollupTier *tier);
+void reset_rollup_tier(RollupTier *tier);
+void fold_into_tier(RollupTier *tier, const RollupBucket *src);
+void merge_bucket(Aggregate out[METRIC_COUNT], const RollupBucket *bucket);
+int query_rollups(RollupTier *tier, int sensor_id, time_t from, time_t to,
+                  Aggregate out[METRIC_COUNT]);
+void display_long_term(int sensor_id, int hours);
+int columns_lower_bound(const HistoryColumns *block, time_t timestamp);
+void put_bits(BitWriter *writer, uint64_t value, int n);
+uint64_t get_bits(BitReader *reader, int n);
+void encode_timestamps(BitWriter *writer, const time_t *values, int count);
+void decode_timestamps(BitReader *reader, time_t *values, int count);
+void encode_floats(BitWriter *writer, const float *values, int count);
+void decode_floats(BitReader *reader, float *values, int count);
+void encode_sensor_ids(BitWriter *writer, const int *values, int count);
+void decode_sensor_ids(BitReader *reader, int *values, int count);
+void fold_columns(const HistoryColumns *columns);
+void seal_open_block();
+void decode_block(const SealedBlock *block, HistoryColumns *out);
+void free_history();
+void reset_history();
+void aggregate_range(const float *values, const int *ids, int sensor_id,
+                     int n, Aggregate *acc);
+int query_history(int sensor_id, time_t from, time_t to,
+                   Aggregate out[METRIC_COUNT]);
+void query_history_locked(int sensor_id, time_t from, time_t to,
+                          Aggregate out[METRIC_COUNT]);
+void display_aggregates(int sensor_id, int window);
+void init_ingest_queue();
+int publish_reading(const SensorLog *log);
+int publish_readings(const SensorLog *logs, int count);
+int drain_ingest_queue();
+void *ingest_consumer(void *arg);
+void start_ingest_consumer();
+void stop_ingest_consumer();
+void run_stress_test(int producers, int seconds);
+SensorLog *read_capture(const char *path, long *count);
+int compare_longs(const void *a, const void *b);
+void run_replay(const char *path, int batch);
+void *stress_producer(void *arg);
+SensorLog *log_at(int position);
+SensorIndex *find_sensor_index(int sensor_id, int create);
+void index_reading(int sensor_id);
+void unindex_oldest(int sensor_id);
+void reset_sensor_index();
+int log_lower_bound(time_t timestamp);
+int sensor_lower_bound(const SensorIndex *index, time_t timestamp);
+void seek_to_time(long timestamp);
+void jump_to_position(int position);
+void show_sensor_range(int sensor_id, long from, long to);
 void navigate_next();
 void navigate_prev();
 void start_live_mode();
@@ -41,72 +401,166 @@ void stop_live_mode();
 void clear_all_logs();
 void display_current_log();
 void display_menu();
-void *sensor_data_generator(void *arg);
+void arm_sample_timer();
+void set_sample_interval(long interval_us);
+void sample_sensors(uint64_t ticks);
+void handle_shutdown_signal(int signal_number);
+void prompt();
+void handle_command(char *line);
+void read_commands();
+int run_event_loop();
 void save_and_exit();
+uint32_t crc32(const void *data, size_t length);
+size_t encode_block(unsigned char *out, int type, const void *payload,
+                    int count, size_t length);
+int write_all(int fd, const unsigned char *data, size_t length);
+int append_block(int fd, int type, const void *payload, int count,
+                 size_t length);
+size_t block_payload_length(const BlockHeader *block);
+int append_rollup_tier(int fd, const RollupTier *tier);
+void restore_rollup(const DiskRollup *record);
+void open_journal(int fd);
+void journal_append(const SensorLog *logs, int count);
+void journal_commit(const DiskRecord *records, int count);
+void *journal_writer(void *arg);
+void start_journal();
+void stop_journal(int32_t current_from_end);
+int create_segment(const char *path);
+int compact_segment(const unsigned char *data, size_t size, long keep, long unfolded,
+                    int32_t current_from_end);
+void import_legacy_session();
 void load_session_state();
 void save_session_state();
-int get_log_position(SensorLog* target);
+int get_log_position();
+
+int main(int argc, char *argv[]) {
+  int capacity = DEFAULT_MAX_LOGS;
+  int history_capacity = DEFAULT_HISTORY_CAPACITY;
+  int stress_producers = 0;
+  int stress_seconds = DEFAULT_STRESS_SECONDS;
+  const char *replay_path = NULL;
+  int replay_batch = DEFAULT_REPLAY_BATCH;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+      capacity = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+      history_capacity = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--raw-minutes") == 0 && i + 1 < argc) {
+      history.raw_window = (time_t)atol(argv[++i]) * 60;
+    } else if (strcmp(argv[i], "--minute-buckets") == 0 && i + 1 < argc) {
+      minute_tier.capacity = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--hour-buckets") == 0 && i + 1 < argc) {
+      hour_tier.capacity = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+      stress_producers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      stress_seconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      replay_batch = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--rate-us") == 0 && i + 1 < argc) {
+      event_loop.sample_interval_us = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--fsync-ms") == 0 && i + 1 < argc) {
+      journal.fsync_interval_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--fsync-batch") == 0 && i + 1 < argc) {
+      journal.batch_size = atoi(argv[++i]);
+    } else {
+      printf("Usage: %s [--capacity N] [--history N] [--raw-minutes N] "
+             "[--minute-buckets N] [--hour-buckets N] [--rate-us US] "
+             "[--fsync-ms MS] [--fsync-batch N] "
+             "[--stress PRODUCERS [--seconds S]] [--replay FILE [--batch N]]\n",
+             argv[0]);
+      return 1;
+    }
+  }
+  if (journal.batch_size <= 0) {
+    journal.batch_size = 1;
+  }
+  if (capacity <= 0 || history_capacity <= 0 || minute_tier.capacity <= 0 ||
+      hour_tier.capacity <= 0) {
+    printf("Capacity must be a positive number of logs.\n");
+    return 1;
+  }
+  if (event_loop.sample_interval_us <= 0) {
+    printf("Sampling interval must be a positive number of microseconds.\n");
+    return 1;
+  }
+
+  if (replay_path) {
+    if (replay_batch <= 0) {
+      printf("Batch size must be a positive number of readings.\n");
+      return 1;
+    }
+    init_log_system(capacity, history_capacity);
+    run_replay(replay_path, replay_batch);
+    cleanup_log_system();
+    return 0;
+  }
+
+  if (stress_producers > 0) {
+    init_log_system(capacity, history_capacity);
+    run_stress_test(stress_producers, stress_seconds);
+    cleanup_log_system();
+    return 0;
+  }
 
-int main() {
   printf("=== IoT Gateway Sensor Logging System ===\n");
-  printf("Initializing system...\n");
-    init_log_system();
+  printf("Initializing system (capacity %d logs)...\n", capacity);
+  init_log_system(capacity, history_capacity);
   
   load_session_state();
+  start_journal();
+  start_ingest_consumer();
   
   if (log_system.count == 0) {
       printf("No saved session found. Creating sample logs...\n");
-      add_log_to_system(create_sensor_log(1, 23.5, 45.2, 1013.25, 0.1));
-      add_log_to_system(create_sensor_log(2, 24.1, 47.8, 1012.80, 0.2));
-      add_log_to_system(create_sensor_log(3, 22.9, 44.1, 1014.10, 0.05));
+      SensorLog samples[] = {create_sensor_log(1, 23.5, 45.2, 1013.25, 0.1),
+                             create_sensor_log(2, 24.1, 47.8, 1012.80, 0.2),
+                             create_sensor_log(3, 22.9, 44.1, 1014.10, 0.05)};
+      for (int i = 0; i < 3; i++) {
+        add_log_to_system(&samples[i]);
+      }
       
-      log_system.current = log_system.head;
+      log_system.current = 0;
   }
 
-  char command;
-  int running = 1;
+  int status = run_event_loop();
 
-  while (running) {
-    display_current_log();
-    display_menu();
+  cleanup_log_system();
+  return status;
+}
 
-    printf("> ");
-    scanf(" %c", &command);
+void init_log_system(int capacity, int history_capacity) {
+  log_system.records = (SensorLog *)malloc(capacity * sizeof(SensorLog));
+  if (!log_system.records) {
+    printf("Error: Could not allocate %d log slots.\n", capacity);
+    exit(1);
+  }
+  log_system.capacity = capacity;
+  log_system.start = 0;
 
-    switch (command) {
-    case 'n':
-      navigate_next();
-      break;
-    case 'p':
-      navigate_prev();
-      break;
-    case 'y':
-      start_live_mode();
-      break;
-    case 'z':
-      stop_live_mode();
-      break;
-    case 'c':
-      clear_all_logs();
-      break;
-    case 's':
-      save_and_exit();
-      running = 0;
-      break;
-    default:
-      printf("Invalid command. Please use n, p, y, z, c, or s.\n");
-    }
+  // Whole sealed blocks always cover at least history_capacity readings;
+  // the open block holds up to one more block on top.
+  history.sealed_capacity = (history_capacity + HISTORY_BLOCK - 1) / HISTORY_BLOCK;
+  history.open = (HistoryColumns *)malloc(sizeof(HistoryColumns));
+  history.scratch = (HistoryColumns *)malloc(sizeof(HistoryColumns));
+  history.sealed = (SealedBlock *)calloc(history.sealed_capacity, sizeof(SealedBlock));
+  if (!history.open || !history.scratch || !history.sealed) {
+    printf("Error: Could not allocate %d history slots.\n", history_capacity);
+    exit(1);
   }
+  history.capacity = history_capacity;
+  reset_history();
 
-  cleanup_log_system();
-  return 0;
-}
+  if (!init_rollup_tier(&minute_tier) || !init_rollup_tier(&hour_tier)) {
+    printf("Error: Could not allocate rollup tiers.\n");
+    exit(1);
+  }
 
-void init_log_system() {
-  log_system.head = NULL;
-  log_system.tail = NULL;
-  log_system.current = NULL;
   log_system.count = 0;
+  log_system.current = -1;
   log_system.live_mode = 0;
   pthread_mutex_init(&log_system.log_mutex, NULL);
 }
@@ -114,72 +568,1361 @@ void init_log_system() {
 void cleanup_log_system() {
   pthread_mutex_lock(&log_system.log_mutex);
 
-  SensorLog *current = log_system.head;
-  while (current != NULL) {
-    SensorLog *next = current->next;
-    free(current);
-    current = next;
+  free(log_system.records);
+  log_system.records = NULL;
+  for (int i = 0; i < sensor_index.size; i++) {
+    free(sensor_index.slots[i].seqs);
   }
+  free(sensor_index.slots);
+  sensor_index.slots = NULL;
+  sensor_index.size = sensor_index.used = 0;
+  free_history();
+  free_rollup_tier(&minute_tier);
+  free_rollup_tier(&hour_tier);
+  log_system.count = 0;
+  log_system.current = -1;
 
   pthread_mutex_unlock(&log_system.log_mutex);
   pthread_mutex_destroy(&log_system.log_mutex);
 }
 
-SensorLog *create_sensor_log(int sensor_id, float temp, float humidity,
-                             float pressure, float vibration) {
-  SensorLog *log = (SensorLog *)malloc(sizeof(SensorLog));
-  if (!log)
-    return NULL;
+SensorLog create_sensor_log(int sensor_id, float temp, float humidity,
+                            float pressure, float vibration) {
+  SensorLog log;
 
-  log->sensor_id = sensor_id;
-  log->temperature = temp;
-  log->humidity = humidity;
-  log->pressure = pressure;
-  log->vibration = vibration;
-  log->timestamp = time(NULL);
-  log->next = NULL;
-  log->prev = NULL;
+  log.sensor_id = sensor_id;
+  log.temperature = temp;
+  log.humidity = humidity;
+  log.pressure = pressure;
+  log.vibration = vibration;
+  log.timestamp = time(NULL);
 
   return log;
 }
 
-void add_log_to_system(SensorLog *log) {
+// Slot of the reading at logical position `position` (0 = oldest).
+// Caller must hold log_mutex.
+SensorLog *log_at(int position) {
+  int slot = log_system.start + position;
+  if (slot >= log_system.capacity) {
+    slot -= log_system.capacity;
+  }
+  return &log_system.records[slot];
+}
+
+void add_log_to_system(const SensorLog *log) {
   if (!log)
     return;
 
+  add_logs_to_system(log, 1);
+}
+
+// Inserts a batch under one acquisition of log_mutex and hands it to the
+// journal in one copy.
+void add_logs_to_system(const SensorLog *logs, int count) {
+  if (!logs || count <= 0)
+    return;
+
+  pthread_mutex_lock(&log_system.log_mutex);
+  for (int i = 0; i < count; i++) {
+    store_log(&logs[i]);
+  }
+  journal_append(logs, count);
+  pthread_mutex_unlock(&log_system.log_mutex);
+}
+
+// Inserts into the ring and history without persisting. Caller must hold
+// log_mutex.
+void store_log(const SensorLog *log) {
+  if (log_system.count == log_system.capacity) {
+    // Overwrite the oldest slot. The reading `current` pointed at shifts
+    // down one position; if it was the oldest it moves to the new oldest.
+    unindex_oldest(log_at(0)->sensor_id);
+    log_system.first_seq++;
+    log_system.start++;
+    if (log_system.start == log_system.capacity) {
+      log_system.start = 0;
+    }
+    log_system.count--;
+    if (log_system.current > 0) {
+      log_system.current--;
+    }
+  }
+
+  *log_at(log_system.count) = *log;
+  index_reading(log->sensor_id);
+  log_system.count++;
+  append_history(log);
+
+  if (log_system.current < 0) {
+    log_system.current = 0;
+  }
+}
+
+// Caller must hold log_mutex.
+void append_history(const SensorLog *log) {
+  HistoryColumns *open = history.open;
+
+  if (open->count == HISTORY_BLOCK) {
+    seal_open_block();
+  }
+  while (history.raw_window > 0 && history.sealed_count > 0 &&
+         history.sealed[history.sealed_start].last_timestamp <
+             log->timestamp - history.raw_window) {
+    evict_history_oldest();
+  }
+
+  int slot = open->count++;
+  open->columns[METRIC_TEMPERATURE][slot] = log->temperature;
+  open->columns[METRIC_HUMIDITY][slot] = log->humidity;
+  open->columns[METRIC_PRESSURE][slot] = log->pressure;
+  open->columns[METRIC_VIBRATION][slot] = log->vibration;
+  open->timestamps[slot] = log->timestamp;
+  open->sensor_ids[slot] = log->sensor_id;
+  history.count++;
+}
+
+// Decodes the oldest sealed block, folds each reading into the minute tier
+// and frees it. Caller must hold log_mutex.
+void evict_history_oldest() {
+  SealedBlock *block = &history.sealed[history.sealed_start];
+
+  decode_block(block, history.scratch);
+  fold_columns(history.scratch);
+
+  history.count -= block->count;
+  history.compressed_bytes -= block->offsets[STREAM_COUNT];
+  free(block->data);
+  block->data = NULL;
+  history.sealed_start = (history.sealed_start + 1) % history.sealed_capacity;
+  history.sealed_count--;
+}
+
+// Folds every reading of `columns` into the minute tier as a
+// single-reading bucket.
+void fold_columns(const HistoryColumns *columns) {
+  RollupBucket single;
+
+  for (int i = 0; i < columns->count; i++) {
+    single.sensor_id = columns->sensor_ids[i];
+    single.start = columns->timestamps[i];
+    single.count = 1;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+      float v = columns->columns[m][i];
+      single.min[m] = v;
+      single.max[m] = v;
+      single.sum[m] = v;
+      single.sum_sq[m] = (double)v * v;
+    }
+    fold_into_tier(&minute_tier, &single);
+  }
+}
+
+// Appends the low `n` bits of `value`, most significant first.
+void put_bits(BitWriter *writer, uint64_t value, int n) {
+  while (n > 0) {
+    if (writer->bit == 8) {
+      writer->data[writer->size++] = 0;
+      writer->bit = 0;
+    }
+    int room = 8 - writer->bit;
+    int take = n < room ? n : room;
+    unsigned int bits = (unsigned int)(value >> (n - take)) & ((1u << take) - 1);
+    writer->data[writer->size - 1] |= (unsigned char)(bits << (room - take));
+    writer->bit += take;
+    n -= take;
+  }
+}
+
+uint64_t get_bits(BitReader *reader, int n) {
+  uint64_t value = 0;
+
+  while (n > 0) {
+    int offset = reader->position & 7;
+    int room = 8 - offset;
+    int take = n < room ? n : room;
+    unsigned int byte = reader->data[reader->position >> 3];
+    value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+    reader->position += take;
+    n -= take;
+  }
+  return value;
+}
+
+// Delta-of-delta: near-periodic sampling makes almost every entry a
+// single '0' bit.
+void encode_timestamps(BitWriter *writer, const time_t *values, int count) {
+  int64_t previous_delta = 0;
+
+  put_bits(writer, (uint64_t)values[0], 64);
+  for (int i = 1; i < count; i++) {
+    int64_t delta = (int64_t)values[i] - (int64_t)values[i - 1];
+    int64_t dod = delta - previous_delta;
+    previous_delta = delta;
+
+    if (dod == 0) {
+      put_bits(writer, 0x0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+      put_bits(writer, 0x2, 2);
+      put_bits(writer, (uint64_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+      put_bits(writer, 0x6, 3);
+      put_bits(writer, (uint64_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+      put_bits(writer, 0xE, 4);
+      put_bits(writer, (uint64_t)(dod + 2047), 12);
+    } else {
+      put_bits(writer, 0xF, 4);
+      put_bits(writer, (uint64_t)dod, 64);
+    }
+  }
+}
+
+void decode_timestamps(BitReader *reader, time_t *values, int count) {
+  int64_t delta = 0;
+
+  values[0] = (time_t)get_bits(reader, 64);
+  for (int i = 1; i < count; i++) {
+    int64_t dod;
+    if (get_bits(reader, 1) == 0) {
+      dod = 0;
+    } else if (get_bits(reader, 1) == 0) {
+      dod = (int64_t)get_bits(reader, 7) - 63;
+    } else if (get_bits(reader, 1) == 0) {
+      dod = (int64_t)get_bits(reader, 9) - 255;
+    } else if (get_bits(reader, 1) == 0) {
+      dod = (int64_t)get_bits(reader, 12) - 2047;
+    } else {
+      dod = (int64_t)get_bits(reader, 64);
+    }
+    delta += dod;
+    values[i] = values[i - 1] + delta;
+  }
+}
+
+// XOR with the previous value: an unchanged reading costs one bit, and a
+// slowly drifting one reuses the previous run of meaningful bits.
+void encode_floats(BitWriter *writer, const float *values, int count) {
+  uint32_t previous;
+  int leading = -1, trailing = 0;
+
+  memcpy(&previous, &values[0], sizeof(previous));
+  put_bits(writer, previous, 32);
+  for (int i = 1; i < count; i++) {
+    uint32_t bits;
+    memcpy(&bits, &values[i], sizeof(bits));
+    uint32_t x = bits ^ previous;
+    previous = bits;
+
+    if (x == 0) {
+      put_bits(writer, 0, 1);
+      continue;
+    }
+    int lz = __builtin_clz(x);
+    int tz = __builtin_ctz(x);
+    if (leading >= 0 && lz >= leading && tz >= trailing) {
+      put_bits(writer, 0x2, 2);
+      put_bits(writer, x >> trailing, 32 - leading - trailing);
+    } else {
+      int length = 32 - lz - tz;
+      put_bits(writer, 0x3, 2);
+      put_bits(writer, lz, 5);
+      put_bits(writer, length - 1, 5);
+      put_bits(writer, x >> tz, length);
+      leading = lz;
+      trailing = tz;
+    }
+  }
+}
+
+void decode_floats(BitReader *reader, float *values, int count) {
+  uint32_t previous = (uint32_t)get_bits(reader, 32);
+  int leading = 0, trailing = 0;
+
+  memcpy(&values[0], &previous, sizeof(previous));
+  for (int i = 1; i < count; i++) {
+    if (get_bits(reader, 1) != 0) {
+      if (get_bits(reader, 1) != 0) {
+        leading = (int)get_bits(reader, 5);
+        int length = (int)get_bits(reader, 5) + 1;
+        trailing = 32 - leading - length;
+      }
+      uint32_t x = (uint32_t)get_bits(reader, 32 - leading - trailing) << trailing;
+      previous ^= x;
+    }
+    memcpy(&values[i], &previous, sizeof(previous));
+  }
+}
+
+// Sensor ids mostly repeat or step by small amounts.
+void encode_sensor_ids(BitWriter *writer, const int *values, int count) {
+  put_bits(writer, (uint32_t)values[0], 32);
+  for (int i = 1; i < count; i++) {
+    int64_t delta = (int64_t)values[i] - values[i - 1];
+    if (delta == 0) {
+      put_bits(writer, 0x0, 1);
+    } else if (delta >= -8 && delta <= 7) {
+      put_bits(writer, 0x2, 2);
+      put_bits(writer, (uint64_t)(delta + 8), 4);
+    } else if (delta >= -32768 && delta <= 32767) {
+      put_bits(writer, 0x6, 3);
+      put_bits(writer, (uint64_t)(delta + 32768), 16);
+    } else {
+      put_bits(writer, 0x7, 3);
+      put_bits(writer, (uint32_t)values[i], 32);
+    }
+  }
+}
+
+void decode_sensor_ids(BitReader *reader, int *values, int count) {
+  values[0] = (int)(uint32_t)get_bits(reader, 32);
+  for (int i = 1; i < count; i++) {
+    if (get_bits(reader, 1) == 0) {
+      values[i] = values[i - 1];
+    } else if (get_bits(reader, 1) == 0) {
+      values[i] = values[i - 1] + (int)get_bits(reader, 4) - 8;
+    } else if (get_bits(reader, 1) == 0) {
+      values[i] = values[i - 1] + (int)get_bits(reader, 16) - 32768;
+    } else {
+      values[i] = (int)(uint32_t)get_bits(reader, 32);
+    }
+  }
+}
+
+// Compresses the full open block into a new sealed block, evicting the
+// oldest sealed block first if the ring is full. Caller must hold
+// log_mutex.
+void seal_open_block() {
+  static unsigned char buffer[HISTORY_BLOCK * MAX_ENCODED_READING];
+  HistoryColumns *open = history.open;
+  BitWriter writer = {buffer, 0, 8};
+  SealedBlock block;
+
+  if (history.sealed_count == history.sealed_capacity) {
+    evict_history_oldest();
+  }
+
+  block.count = open->count;
+  block.first_timestamp = open->timestamps[0];
+  block.last_timestamp = open->timestamps[open->count - 1];
+  for (int stream = 0; stream < STREAM_COUNT; stream++) {
+    block.offsets[stream] = writer.size;
+    writer.bit = 8; // every stream starts on a byte boundary
+    if (stream < METRIC_COUNT) {
+      encode_floats(&writer, open->columns[stream], open->count);
+    } else if (stream == STREAM_TIMESTAMP) {
+      encode_timestamps(&writer, open->timestamps, open->count);
+    } else {
+      encode_sensor_ids(&writer, open->sensor_ids, open->count);
+    }
+  }
+  block.offsets[STREAM_COUNT] = writer.size;
+
+  block.data = (unsigned char *)malloc(writer.size);
+  if (!block.data) {
+    // Out of memory: fold the block straight into the rollups instead.
+    fold_columns(open);
+    history.count -= open->count;
+    open->count = 0;
+    return;
+  }
+  memcpy(block.data, buffer, writer.size);
+
+  history.sealed[(history.sealed_start + history.sealed_count) % history.sealed_capacity] = block;
+  history.sealed_count++;
+  history.compressed_bytes += writer.size;
+  open->count = 0;
+}
+
+// Streams every column of `block` into `out`.
+void decode_block(const SealedBlock *block, HistoryColumns *out) {
+  for (int stream = 0; stream < STREAM_COUNT; stream++) {
+    BitReader reader = {block->data + block->offsets[stream], 0};
+    if (stream < METRIC_COUNT) {
+      decode_floats(&reader, out->columns[stream], block->count);
+    } else if (stream == STREAM_TIMESTAMP) {
+      decode_timestamps(&reader, out->timestamps, block->count);
+    } else {
+      decode_sensor_ids(&reader, out->sensor_ids, block->count);
+    }
+  }
+  out->count = block->count;
+}
+
+void free_history() {
+  reset_history();
+  free(history.open);
+  free(history.scratch);
+  free(history.sealed);
+  history.open = history.scratch = NULL;
+  history.sealed = NULL;
+}
+
+// Caller must hold log_mutex (or be single-threaded).
+void reset_history() {
+  for (int i = 0; i < history.sealed_count; i++) {
+    SealedBlock *block = &history.sealed[(history.sealed_start + i) % history.sealed_capacity];
+    free(block->data);
+    block->data = NULL;
+  }
+  history.sealed_start = 0;
+  history.sealed_count = 0;
+  history.count = 0;
+  history.compressed_bytes = 0;
+  if (history.open) {
+    history.open->count = 0;
+  }
+}
+
+// Returns the value slot for `sensor_id`, inserting it (as 0) if absent.
+unsigned long *sensor_slot(SensorSlotMap *map, int sensor_id) {
+  if ((map->used + 1) * 2 > map->size) {
+    SensorSlotMap old = *map;
+    int size = old.size ? old.size * 2 : SENSOR_INDEX_INITIAL;
+    map->keys = (int *)malloc(size * sizeof(int));
+    map->values = (unsigned long *)calloc(size, sizeof(unsigned long));
+    if (!map->keys || !map->values) {
+      free(map->keys);
+      free(map->values);
+      *map = old;
+      return NULL;
+    }
+    map->size = size;
+    map->used = 0;
+    for (int i = 0; i < old.size; i++) {
+      if (old.values[i]) {
+        *sensor_slot(map, old.keys[i]) = old.values[i];
+      }
+    }
+    free(old.keys);
+    free(old.values);
+  }
+
+  unsigned int mask = map->size - 1;
+  unsigned int slot = ((unsigned int)sensor_id * 2654435761u) & mask;
+  while (map->values[slot]) {
+    if (map->keys[slot] == sensor_id) {
+      return &map->values[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  // Claimed by the caller storing a non-zero value.
+  map->keys[slot] = sensor_id;
+  map->used++;
+  return &map->values[slot];
+}
+
+int init_rollup_tier(RollupTier *tier) {
+  tier->buckets = (RollupBucket *)malloc(tier->capacity * sizeof(RollupBucket));
+  tier->start = 0;
+  tier->count = 0;
+  tier->first_seq = 0;
+  return tier->buckets != NULL;
+}
+
+void free_rollup_tier(RollupTier *tier) {
+  free(tier->buckets);
+  free(tier->newest.keys);
+  free(tier->newest.values);
+  tier->buckets = NULL;
+  memset(&tier->newest, 0, sizeof(tier->newest));
+  tier->count = 0;
+}
+
+void reset_rollup_tier(RollupTier *tier) {
+  tier->start = 0;
+  tier->count = 0;
+  tier->first_seq = 0;
+  if (tier->newest.values) {
+    memset(tier->newest.values, 0, tier->newest.size * sizeof(unsigned long));
+  }
+  tier->newest.used = 0;
+}
+
+// Merges `src` (a raw reading or a finer bucket) into the sensor's bucket
+// for the aligned period, creating it if needed. Input arrives in time
+// order, so only the sensor's newest bucket can match.
+void fold_into_tier(RollupTier *tier, const RollupBucket *src) {
+  time_t start = src->start - src->start % tier->granularity;
+  unsigned long *newest = sensor_slot(&tier->newest, src->sensor_id);
+  RollupBucket *bucket = NULL;
+
+  if (newest && *newest > tier->first_seq) {
+    RollupBucket *candidate =
+        &tier->buckets[(tier->start + (*newest - 1 - tier->first_seq)) % tier->capacity];
+    if (candidate->start == start) {
+      bucket = candidate;
+    }
+  }
+
+  if (!bucket) {
+    if (tier->count == tier->capacity) {
+      RollupBucket *oldest = &tier->buckets[tier->start];
+      if (tier->next) {
+        fold_into_tier(tier->next, oldest);
+      }
+      tier->start = (tier->start + 1) % tier->capacity;
+      tier->count--;
+      tier->first_seq++;
+    }
+    bucket = &tier->buckets[(tier->start + tier->count) % tier->capacity];
+    tier->count++;
+    if (newest) {
+      *newest = tier->first_seq + tier->count; // sequence + 1
+    }
+    *bucket = *src;
+    bucket->start = start;
+    return;
+  }
+
+  bucket->count += src->count;
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    if (src->min[m] < bucket->min[m]) bucket->min[m] = src->min[m];
+    if (src->max[m] > bucket->max[m]) bucket->max[m] = src->max[m];
+    bucket->sum[m] += src->sum[m];
+    bucket->sum_sq[m] += src->sum_sq[m];
+  }
+}
+
+void merge_bucket(Aggregate out[METRIC_COUNT], const RollupBucket *bucket) {
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    if (bucket->min[m] < out[m].min) out[m].min = bucket->min[m];
+    if (bucket->max[m] > out[m].max) out[m].max = bucket->max[m];
+    out[m].sum += bucket->sum[m];
+    out[m].sum_sq += bucket->sum_sq[m];
+    out[m].count += bucket->count;
+  }
+}
+
+// Adds every bucket of `tier` whose period overlaps [from, to] to `out`
+// and returns how many buckets were read. Caller must hold log_mutex.
+int query_rollups(RollupTier *tier, int sensor_id, time_t from, time_t to,
+                  Aggregate out[METRIC_COUNT]) {
+  int lo = 0, hi = tier->count, read = 0;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    const RollupBucket *bucket = &tier->buckets[(tier->start + mid) % tier->capacity];
+    if (bucket->start + tier->granularity <= from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (int i = lo; i < tier->count; i++) {
+    const RollupBucket *bucket = &tier->buckets[(tier->start + i) % tier->capacity];
+    if (bucket->start > to)
+      break;
+    if (sensor_id > 0 && bucket->sensor_id != sensor_id)
+      continue;
+    merge_bucket(out, bucket);
+    read++;
+  }
+  return read;
+}
+
+// Long-range summary: hour and minute rollups for the old part of the
+// window plus the raw tier for the recent part. Every reading lives in
+// exactly one tier, so the three add up without double counting; rollup
+// buckets are counted whole, so window edges are approximate to their
+// granularity.
+void display_long_term(int sensor_id, int hours) {
+  Aggregate stats[METRIC_COUNT], raw[METRIC_COUNT];
+  time_t to = time(NULL);
+  time_t from = hours > 0 ? to - (time_t)hours * 3600 : 0;
+
+  pthread_mutex_lock(&log_system.log_mutex);
+  query_history_locked(sensor_id, from, (time_t)LONG_MAX, raw);
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    stats[m] = raw[m];
+  }
+  int hour_buckets = query_rollups(&hour_tier, sensor_id, from, (time_t)LONG_MAX, stats);
+  int minute_buckets = query_rollups(&minute_tier, sensor_id, from, (time_t)LONG_MAX, stats);
+  // The ingest consumer keeps sealing blocks, so take the tier sizes now.
+  int raw_count = history.count;
+  int sealed_count = history.sealed_count;
+  long sealed = sealed_count > 0 ? history.count - history.open->count : 0;
+  size_t compressed_bytes = history.compressed_bytes;
+  pthread_mutex_unlock(&log_system.log_mutex);
+
+  if (sensor_id > 0) {
+    printf("\n=== Long-term: sensor %03d", sensor_id);
+  } else {
+    printf("\n=== Long-term: all sensors");
+  }
+  if (hours > 0) {
+    printf(", last %d h (%d readings) ===\n", hours, stats[0].count);
+  } else {
+    printf(", all retained history (%d readings) ===\n", stats[0].count);
+  }
+  printf("Sources: %d hour buckets, %d minute buckets, %d raw readings\n",
+         hour_buckets, minute_buckets, raw[0].count);
+  if (sealed_count > 0) {
+    printf("Raw tier: %d readings, %d sealed blocks at %.1f bytes/reading "
+           "(%.1fx smaller than columns)\n",
+           raw_count, sealed_count, (double)compressed_bytes / sealed,
+           (double)sealed * (METRIC_COUNT * sizeof(float) + sizeof(time_t) + sizeof(int)) /
+               compressed_bytes);
+  }
+  if (stats[0].count == 0) {
+    printf("No readings in range.\n");
+    return;
+  }
+
+  printf("%-12s %10s %10s %10s %10s\n", "Metric", "Min", "Max", "Mean", "StdDev");
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    double mean = stats[m].sum / stats[m].count;
+    double variance = stats[m].sum_sq / stats[m].count - mean * mean;
+    printf("%-12s %10.2f %10.2f %10.2f %10.2f\n", metric_names[m], stats[m].min,
+           stats[m].max, mean, sqrt(variance > 0 ? variance : 0));
+  }
+}
+
+// First index in `block` whose timestamp is >= `timestamp`. Readings are
+// appended in arrival order, so timestamps are non-decreasing.
+int columns_lower_bound(const HistoryColumns *block, time_t timestamp) {
+  int lo = 0, hi = block->count;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (block->timestamps[mid] < timestamp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+static void aggregate_scalar(const float *values, const int *ids, int sensor_id,
+                             int n, Aggregate *acc) {
+  for (int i = 0; i < n; i++) {
+    if (sensor_id > 0 && ids[i] != sensor_id)
+      continue;
+    float v = values[i];
+    if (v < acc->min) acc->min = v;
+    if (v > acc->max) acc->max = v;
+    acc->sum += v;
+    acc->sum_sq += (double)v * v;
+    acc->count++;
+  }
+}
+
+#if defined(__SSE2__)
+// Four lanes at a time. Readings from other sensors are masked to +inf/-inf
+// for min/max and to 0 for the sums; sums are widened to double so stddev
+// stays accurate over millions of samples.
+static int aggregate_sse2(const float *values, const int *ids, int sensor_id,
+                          int n, Aggregate *acc) {
+  __m128 vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+  __m128 pos_inf = vmin, neg_inf = vmax;
+  __m128d sum = _mm_setzero_pd(), sum_sq = _mm_setzero_pd();
+  __m128i want = _mm_set1_epi32(sensor_id);
+  int i = 0, count = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_loadu_ps(values + i);
+    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    if (sensor_id > 0) {
+      mask = _mm_castsi128_ps(
+          _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(ids + i)), want));
+    }
+    __m128 kept = _mm_and_ps(mask, v);
+    vmin = _mm_min_ps(vmin, _mm_or_ps(kept, _mm_andnot_ps(mask, pos_inf)));
+    vmax = _mm_max_ps(vmax, _mm_or_ps(kept, _mm_andnot_ps(mask, neg_inf)));
+    __m128d lo = _mm_cvtps_pd(kept);
+    __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(kept, kept));
+    sum = _mm_add_pd(sum, _mm_add_pd(lo, hi));
+    sum_sq = _mm_add_pd(sum_sq, _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+    count += __builtin_popcount(_mm_movemask_ps(mask));
+  }
+
+  float mins[4], maxs[4];
+  double sums[2], sq[2];
+  _mm_storeu_ps(mins, vmin);
+  _mm_storeu_ps(maxs, vmax);
+  _mm_storeu_pd(sums, sum);
+  _mm_storeu_pd(sq, sum_sq);
+  for (int k = 0; k < 4; k++) {
+    if (mins[k] < acc->min) acc->min = mins[k];
+    if (maxs[k] > acc->max) acc->max = maxs[k];
+  }
+  acc->sum += sums[0] + sums[1];
+  acc->sum_sq += sq[0] + sq[1];
+  acc->count += count;
+  return i;
+}
+
+// Same as aggregate_sse2 with eight lanes; only used when the CPU has AVX2.
+__attribute__((target("avx,avx2"))) static int
+aggregate_avx2(const float *values, const int *ids, int sensor_id, int n,
+              Aggregate *acc) {
+  __m256 vmin = _mm256_set1_ps(INFINITY), vmax = _mm256_set1_ps(-INFINITY);
+  __m256 pos_inf = vmin, neg_inf = vmax;
+  __m256d sum = _mm256_setzero_pd(), sum_sq = _mm256_setzero_pd();
+  __m256i want = _mm256_set1_epi32(sensor_id);
+  int i = 0, count = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(values + i);
+    __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    if (sensor_id > 0) {
+      mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+          _mm256_loadu_si256((const __m256i *)(ids + i)), want));
+    }
+    __m256 kept = _mm256_and_ps(mask, v);
+    vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(pos_inf, v, mask));
+    vmax = _mm256_max_ps(vmax, _mm256_blendv_ps(neg_inf, v, mask));
+    __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(kept));
+    __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1));
+    sum = _mm256_add_pd(sum, _mm256_add_pd(lo, hi));
+    sum_sq = _mm256_add_pd(sum_sq, _mm256_add_pd(_mm256_mul_pd(lo, lo),
+                                                 _mm256_mul_pd(hi, hi)));
+    count += __builtin_popcount(_mm256_movemask_ps(mask));
+  }
+
+  float mins[8], maxs[8];
+  double sums[4], sq[4];
+  _mm256_storeu_ps(mins, vmin);
+  _mm256_storeu_ps(maxs, vmax);
+  _mm256_storeu_pd(sums, sum);
+  _mm256_storeu_pd(sq, sum_sq);
+  for (int k = 0; k < 8; k++) {
+    if (mins[k] < acc->min) acc->min = mins[k];
+    if (maxs[k] > acc->max) acc->max = maxs[k];
+  }
+  acc->sum += sums[0] + sums[1] + sums[2] + sums[3];
+  acc->sum_sq += sq[0] + sq[1] + sq[2] + sq[3];
+  acc->count += count;
+  return i;
+}
+#endif
+
+// Folds values[0..n) into acc, restricted to `sensor_id` when it is > 0.
+// Picks the widest vector kernel the CPU supports and finishes the tail
+// with the scalar loop.
+void aggregate_range(const float *values, const int *ids, int sensor_id,
+                     int n, Aggregate *acc) {
+  int done = 0;
+
+#if defined(__SSE2__)
+  static int has_avx2 = -1;
+  if (has_avx2 < 0) {
+    has_avx2 = __builtin_cpu_supports("avx2");
+  }
+  done = has_avx2 ? aggregate_avx2(values, ids, sensor_id, n, acc)
+                  : aggregate_sse2(values, ids, sensor_id, n, acc);
+#endif
+
+  aggregate_scalar(values + done, ids + done, sensor_id, n - done, acc);
+}
+
+// Aggregates every metric over readings with from <= timestamp <= to,
+// for one sensor (sensor_id > 0) or all of them. Returns the match count.
+int query_history(int sensor_id, time_t from, time_t to,
+                  Aggregate out[METRIC_COUNT]) {
+  pthread_mutex_lock(&log_system.log_mutex);
+  query_history_locked(sensor_id, from, to, out);
+  pthread_mutex_unlock(&log_system.log_mutex);
+  return out[0].count;
+}
+
+// Body of query_history for callers already holding log_mutex.
+void query_history_locked(int sensor_id, time_t from, time_t to,
+                          Aggregate out[METRIC_COUNT]) {
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    out[m].count = 0;
+    out[m].min = INFINITY;
+    out[m].max = -INFINITY;
+    out[m].sum = 0;
+    out[m].sum_sq = 0;
+  }
+
+  // Sealed blocks outside the window are skipped on their timestamp
+  // bounds; overlapping ones are decoded one at a time into scratch.
+  for (int b = 0; b <= history.sealed_count; b++) {
+    const HistoryColumns *block;
+
+    if (b < history.sealed_count) {
+      const SealedBlock *sealed =
+          &history.sealed[(history.sealed_start + b) % history.sealed_capacity];
+      if (sealed->last_timestamp < from || sealed->first_timestamp > to)
+        continue;
+      decode_block(sealed, history.scratch);
+      block = history.scratch;
+    } else {
+      block = history.open;
+    }
+
+    int first = columns_lower_bound(block, from);
+    int last = to == (time_t)LONG_MAX ? block->count : columns_lower_bound(block, to + 1);
+    if (first >= last)
+      continue;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+      aggregate_range(block->columns[m] + first, block->sensor_ids + first,
+                      sensor_id, last - first, &out[m]);
+    }
+  }
+}
+
+void display_aggregates(int sensor_id, int window) {
+  Aggregate stats[METRIC_COUNT];
+
+  time_t to = time(NULL);
+  time_t from = window > 0 ? to - window : 0;
+  int count = query_history(sensor_id, from, window > 0 ? to : (time_t)LONG_MAX, stats);
+
+  if (sensor_id > 0) {
+    printf("\n=== Aggregates: sensor %03d", sensor_id);
+  } else {
+    printf("\n=== Aggregates: all sensors");
+  }
+  if (window > 0) {
+    printf(", last %d s (%d readings) ===\n", window, count);
+  } else {
+    printf(", all history (%d readings) ===\n", count);
+  }
+  if (count == 0) {
+    printf("No readings in range.\n");
+    return;
+  }
+
+  printf("%-12s %10s %10s %10s %10s\n", "Metric", "Min", "Max", "Mean", "StdDev");
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    double mean = stats[m].sum / stats[m].count;
+    double variance = stats[m].sum_sq / stats[m].count - mean * mean;
+    printf("%-12s %10.2f %10.2f %10.2f %10.2f\n", metric_names[m], stats[m].min,
+           stats[m].max, mean, sqrt(variance > 0 ? variance : 0));
+  }
+}
+
+void init_ingest_queue() {
+  for (unsigned long i = 0; i < INGEST_QUEUE_SIZE; i++) {
+    ingest_queue.slots[i].sequence = i;
+  }
+  ingest_queue.enqueue_pos = 0;
+  ingest_queue.dequeue_pos = 0;
+  ingest_queue.consumed = 0;
+  ingest_queue.dropped = 0;
+}
+
+// Lock-free enqueue, safe from any number of producer threads. Returns 0
+// when the queue is full rather than blocking; the caller decides whether
+// to retry or drop.
+int publish_reading(const SensorLog *log) {
+  return publish_readings(log, 1);
+}
+
+// Claims `count` consecutive slots with a single CAS and fills them.
+// All or nothing: returns 0 without publishing anything when the queue
+// lacks room for the whole batch. The consumer frees slots in order, so
+// the last slot of the range being free means all of them are.
+int publish_readings(const SensorLog *logs, int count) {
+  if (count <= 0 || count > INGEST_QUEUE_SIZE)
+    return 0;
+
+  unsigned long pos = __atomic_load_n(&ingest_queue.enqueue_pos, __ATOMIC_RELAXED);
+
+  for (;;) {
+    IngestSlot *first = &ingest_queue.slots[pos & (INGEST_QUEUE_SIZE - 1)];
+    IngestSlot *last = &ingest_queue.slots[(pos + count - 1) & (INGEST_QUEUE_SIZE - 1)];
+    long diff = (long)__atomic_load_n(&first->sequence, __ATOMIC_ACQUIRE) - (long)pos;
+    long last_diff = (long)__atomic_load_n(&last->sequence, __ATOMIC_ACQUIRE) -
+                     (long)(pos + count - 1);
+
+    if (diff == 0 && last_diff == 0) {
+      if (__atomic_compare_exchange_n(&ingest_queue.enqueue_pos, &pos, pos + count,
+                                      1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0 || last_diff < 0) {
+      return 0;
+    } else {
+      pos = __atomic_load_n(&ingest_queue.enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    IngestSlot *slot = &ingest_queue.slots[(pos + i) & (INGEST_QUEUE_SIZE - 1)];
+    slot->log = logs[i];
+    __atomic_store_n(&slot->sequence, pos + i + 1, __ATOMIC_RELEASE);
+  }
+  return count;
+}
+
+// Moves up to INGEST_BATCH published readings into log_system with one
+// add_logs_to_system call. Only the ingest consumer thread may call this.
+// Returns the number drained.
+int drain_ingest_queue() {
+  SensorLog batch[INGEST_BATCH];
+  int drained = 0;
+
+  while (drained < INGEST_BATCH) {
+    unsigned long pos = ingest_queue.dequeue_pos;
+    IngestSlot *slot = &ingest_queue.slots[pos & (INGEST_QUEUE_SIZE - 1)];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+      break;
+    }
+
+    batch[drained++] = slot->log;
+    __atomic_store_n(&slot->sequence, pos + INGEST_QUEUE_SIZE, __ATOMIC_RELEASE);
+    ingest_queue.dequeue_pos = pos + 1;
+  }
+
+  add_logs_to_system(batch, drained);
+  __atomic_fetch_add(&ingest_queue.consumed, drained, __ATOMIC_RELAXED);
+  return drained;
+}
+
+void *ingest_consumer(void *arg) {
+  (void)arg;
+  struct timespec idle = {0, 200000};
+
+  while (__atomic_load_n(&ingest_queue.running, __ATOMIC_ACQUIRE)) {
+    if (drain_ingest_queue() == 0) {
+      nanosleep(&idle, NULL);
+    }
+  }
+
+  // Flush whatever producers published before shutdown.
+  while (drain_ingest_queue() > 0) {
+  }
+
+  return NULL;
+}
+
+void start_ingest_consumer() {
+  init_ingest_queue();
+  __atomic_store_n(&ingest_queue.running, 1, __ATOMIC_RELEASE);
+  pthread_create(&ingest_queue.consumer, NULL, ingest_consumer, NULL);
+}
+
+void stop_ingest_consumer() {
+  __atomic_store_n(&ingest_queue.running, 0, __ATOMIC_RELEASE);
+  pthread_join(ingest_queue.consumer, NULL);
+}
+
+typedef struct {
+  int sensor_id;
+  int *stop;
+  unsigned long published;
+  unsigned long retries;
+} StressProducer;
+
+void *stress_producer(void *arg) {
+  StressProducer *producer = (StressProducer *)arg;
+  unsigned int seed = (unsigned int)producer->sensor_id;
+  SensorLog log = create_sensor_log(producer->sensor_id, 0, 0, 0, 0);
+
+  while (!__atomic_load_n(producer->stop, __ATOMIC_RELAXED)) {
+    log.temperature = 20.0 + (rand_r(&seed) % 100) / 10.0;
+    log.humidity = 30.0 + (rand_r(&seed) % 400) / 10.0;
+    log.pressure = 1000.0 + (rand_r(&seed) % 300) / 10.0;
+    log.vibration = (rand_r(&seed) % 50) / 100.0;
+
+    // Back off instead of dropping so the test measures sustained rate.
+    while (!publish_reading(&log)) {
+      if (__atomic_load_n(producer->stop, __ATOMIC_RELAXED)) {
+        return NULL;
+      }
+      producer->retries++;
+      sched_yield();
+    }
+    producer->published++;
+  }
+
+  return NULL;
+}
+
+void run_stress_test(int producers, int seconds) {
+  StressProducer *workers = (StressProducer *)calloc(producers, sizeof(StressProducer));
+  pthread_t *threads = (pthread_t *)malloc(producers * sizeof(pthread_t));
+  int stop = 0;
+  struct timespec begin, end;
+
+  if (!workers || !threads) {
+    printf("Error: Could not allocate %d producers.\n", producers);
+    free(workers);
+    free(threads);
+    return;
+  }
+
+  printf("Stress test: %d producers for %d s into %d log slots...\n",
+         producers, seconds, log_system.capacity);
+
+  start_ingest_consumer();
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for (int i = 0; i < producers; i++) {
+    workers[i].sensor_id = i + 1;
+    workers[i].stop = &stop;
+    pthread_create(&threads[i], NULL, stress_producer, &workers[i]);
+  }
+
+  sleep(seconds);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+  unsigned long published = 0, retries = 0;
+  for (int i = 0; i < producers; i++) {
+    pthread_join(threads[i], NULL);
+    published += workers[i].published;
+    retries += workers[i].retries;
+  }
+
+  stop_ingest_consumer();
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+  printf("Published: %lu readings\n", published);
+  printf("Consumed:  %lu readings\n", ingest_queue.consumed);
+  printf("Queue-full retries: %lu\n", retries);
+  printf("Sustained: %.0f readings/sec\n", ingest_queue.consumed / elapsed);
+
+  free(workers);
+  free(threads);
+}
+
+// Loads a recorded capture into memory: either a session segment (as
+// written to SESSION_FILE) or CSV lines of
+// sensor_id,temperature,humidity,pressure,vibration,timestamp. Lines that
+// do not parse, such as a header, are skipped.
+SensorLog *read_capture(const char *path, long *count) {
+  FILE *file = fopen(path, "rb");
+  uint32_t magic = 0;
+  long capacity = CAPTURE_INITIAL;
+  SensorLog *logs;
+
+  *count = 0;
+  if (!file) {
+    printf("Error: Could not open capture %s.\n", path);
+    return NULL;
+  }
+  logs = (SensorLog *)malloc(capacity * sizeof(SensorLog));
+  if (!logs) {
+    fclose(file);
+    return NULL;
+  }
+
+  if (fread(&magic, sizeof(magic), 1, file) == 1 && magic == SESSION_MAGIC) {
+    struct stat st;
+    unsigned char *data = NULL;
+
+    if (fstat(fileno(file), &st) == 0 && st.st_size >= (off_t)sizeof(SegmentHeader)) {
+      data = (unsigned char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                                   fileno(file), 0);
+    }
+    if (!data || data == MAP_FAILED) {
+      printf("Error: Could not map capture %s.\n", path);
+      fclose(file);
+      free(logs);
+      return NULL;
+    }
+
+    size_t size = st.st_size;
+    size_t offset = sizeof(SegmentHeader);
+    while (offset + sizeof(BlockHeader) <= size) {
+      const BlockHeader *block = (const BlockHeader *)(data + offset);
+      const unsigned char *payload = data + offset + sizeof(BlockHeader);
+      size_t length = block_payload_length(block);
+
+      if (block->type > BLOCK_ROLLUP || offset + sizeof(BlockHeader) + length > size ||
+          crc32(payload, length) != block->crc) {
+        printf("Warning: Capture is damaged after %ld readings.\n", *count);
+        break;
+      }
+      if (block->type == BLOCK_DATA) {
+        const DiskRecord *records = (const DiskRecord *)payload;
+        while (*count + block->count > capacity) {
+          capacity *= 2;
+        }
+        SensorLog *grown = (SensorLog *)realloc(logs, capacity * sizeof(SensorLog));
+        if (!grown) {
+          break;
+        }
+        logs = grown;
+        for (uint32_t i = 0; i < block->count; i++) {
+          SensorLog *log = &logs[(*count)++];
+          log->timestamp = records[i].timestamp;
+          log->sensor_id = records[i].sensor_id;
+          log->temperature = records[i].temperature;
+          log->humidity = records[i].humidity;
+          log->pressure = records[i].pressure;
+          log->vibration = records[i].vibration;
+        }
+      }
+      offset += sizeof(BlockHeader) + length;
+    }
+    munmap(data, size);
+  } else {
+    char line[COMMAND_BUFFER];
+    long skipped = 0;
+
+    rewind(file);
+    while (fgets(line, sizeof(line), file)) {
+      SensorLog log;
+      long timestamp;
+
+      if (sscanf(line, "%d,%f,%f,%f,%f,%ld", &log.sensor_id, &log.temperature,
+                 &log.humidity, &log.pressure, &log.vibration, &timestamp) != 6) {
+        skipped++;
+        continue;
+      }
+      log.timestamp = (time_t)timestamp;
+      if (*count == capacity) {
+        SensorLog *grown = (SensorLog *)realloc(logs, capacity * 2 * sizeof(SensorLog));
+        if (!grown) {
+          break;
+        }
+        logs = grown;
+        capacity *= 2;
+      }
+      logs[(*count)++] = log;
+    }
+    if (skipped > 0) {
+      printf("Skipped %ld unparseable capture lines.\n", skipped);
+    }
+  }
+
+  fclose(file);
+  return logs;
+}
+
+int compare_longs(const void *a, const void *b) {
+  long x = *(const long *)a, y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+// Streams a capture through add_logs_to_system as fast as possible, `batch`
+// readings per call, and reports throughput and per-call latency. The
+// capture is loaded up front so file I/O is not measured; nothing is
+// journaled and the saved session is left alone.
+void run_replay(const char *path, int batch) {
+  long count;
+  SensorLog *logs = read_capture(path, &count);
+  struct timespec begin, end, before, after;
+
+  if (!logs)
+    return;
+  if (count == 0) {
+    printf("Capture %s holds no readings.\n", path);
+    free(logs);
+    return;
+  }
+
+  long calls = (count + batch - 1) / batch;
+  long *latencies = (long *)malloc(calls * sizeof(long));
+  if (!latencies) {
+    free(logs);
+    return;
+  }
+
+  printf("Replaying %ld readings from %s in batches of %d...\n", count, path, batch);
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for (long call = 0; call < calls; call++) {
+    long first = call * batch;
+    int n = count - first < batch ? (int)(count - first) : batch;
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    add_logs_to_system(logs + first, n);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    latencies[call] = (after.tv_sec - before.tv_sec) * 1000000000L +
+                      (after.tv_nsec - before.tv_nsec);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  qsort(latencies, calls, sizeof(long), compare_longs);
+  double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+  printf("Inserted:   %ld readings in %.3f s\n", count, elapsed);
+  printf("Throughput: %.0f readings/sec\n", count / elapsed);
+  printf("Insert latency per %d-reading call: p50 %ld ns, p99 %ld ns, max %ld ns\n",
+         batch, latencies[calls / 2], latencies[(calls * 99) / 100], latencies[calls - 1]);
+
+  free(latencies);
+  free(logs);
+}
+
+// Caller must hold log_mutex.
+SensorIndex *find_sensor_index(int sensor_id, int create) {
+  if (sensor_index.size == 0) {
+    if (!create)
+      return NULL;
+    sensor_index.slots = (SensorIndex *)calloc(SENSOR_INDEX_INITIAL, sizeof(SensorIndex));
+    if (!sensor_index.slots)
+      return NULL;
+    sensor_index.size = SENSOR_INDEX_INITIAL;
+  }
+
+  unsigned int mask = sensor_index.size - 1;
+  unsigned int slot = ((unsigned int)sensor_id * 2654435761u) & mask;
+  while (sensor_index.slots[slot].used) {
+    if (sensor_index.slots[slot].sensor_id == sensor_id) {
+      return &sensor_index.slots[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  if (!create)
+    return NULL;
+
+  if ((sensor_index.used + 1) * 2 > sensor_index.size) {
+    // Rehash into a table twice the size, keeping load under one half.
+    SensorIndexMap old = sensor_index;
+    sensor_index.slots = (SensorIndex *)calloc(old.size * 2, sizeof(SensorIndex));
+    if (!sensor_index.slots) {
+      sensor_index = old;
+      return NULL;
+    }
+    sensor_index.size = old.size * 2;
+    mask = sensor_index.size - 1;
+    for (int i = 0; i < old.size; i++) {
+      if (!old.slots[i].used)
+        continue;
+      unsigned int s = ((unsigned int)old.slots[i].sensor_id * 2654435761u) & mask;
+      while (sensor_index.slots[s].used) {
+        s = (s + 1) & mask;
+      }
+      sensor_index.slots[s] = old.slots[i];
+    }
+    free(old.slots);
+    return find_sensor_index(sensor_id, create);
+  }
+
+  sensor_index.slots[slot].used = 1;
+  sensor_index.slots[slot].sensor_id = sensor_id;
+  sensor_index.used++;
+  return &sensor_index.slots[slot];
+}
+
+// Records that the reading about to become position `count` belongs to
+// `sensor_id`. Caller must hold log_mutex.
+void index_reading(int sensor_id) {
+  SensorIndex *index = find_sensor_index(sensor_id, 1);
+  if (!index)
+    return;
+
+  if (index->head + index->count == index->capacity) {
+    if (index->head > 0) {
+      // Reuse the space freed by evictions before growing.
+      memmove(index->seqs, index->seqs + index->head, index->count * sizeof(unsigned long));
+      index->head = 0;
+    } else {
+      int capacity = index->capacity ? index->capacity * 2 : 16;
+      unsigned long *grown =
+          (unsigned long *)realloc(index->seqs, capacity * sizeof(unsigned long));
+      if (!grown)
+        return;
+      index->seqs = grown;
+      index->capacity = capacity;
+    }
+  }
+
+  index->seqs[index->head + index->count] = log_system.first_seq + log_system.count;
+  index->count++;
+}
+
+// Caller must hold log_mutex.
+void unindex_oldest(int sensor_id) {
+  SensorIndex *index = find_sensor_index(sensor_id, 0);
+  if (index && index->count > 0) {
+    index->head++;
+    index->count--;
+  }
+}
+
+// Caller must hold log_mutex.
+void reset_sensor_index() {
+  for (int i = 0; i < sensor_index.size; i++) {
+    sensor_index.slots[i].head = 0;
+    sensor_index.slots[i].count = 0;
+  }
+  log_system.first_seq = 0;
+}
+
+// First ring position with timestamp >= `timestamp`. Readings arrive in
+// time order, so this is a binary search. Caller must hold log_mutex.
+int log_lower_bound(time_t timestamp) {
+  int lo = 0, hi = log_system.count;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (log_at(mid)->timestamp < timestamp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// First entry of `index` whose reading has timestamp >= `timestamp`.
+// Caller must hold log_mutex.
+int sensor_lower_bound(const SensorIndex *index, time_t timestamp) {
+  int lo = 0, hi = index->count;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    unsigned long seq = index->seqs[index->head + mid];
+    if (log_at((int)(seq - log_system.first_seq))->timestamp < timestamp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void seek_to_time(long timestamp) {
+  pthread_mutex_lock(&log_system.log_mutex);
+  int position = log_lower_bound((time_t)timestamp);
+  if (log_system.count == 0) {
+    printf("No logs available.\n");
+  } else if (position == log_system.count) {
+    log_system.current = log_system.count - 1;
+    printf("No log at or after that time; showing the most recent log.\n");
+  } else {
+    log_system.current = position;
+    printf("Seeked to first log at or after %ld.\n", timestamp);
+  }
+  pthread_mutex_unlock(&log_system.log_mutex);
+}
+
+void jump_to_position(int position) {
   pthread_mutex_lock(&log_system.log_mutex);
+  if (position >= 1 && position <= log_system.count) {
+    log_system.current = position - 1;
+    printf("Jumped to log %d.\n", position);
+  } else {
+    printf("Position must be between 1 and %d.\n", log_system.count);
+  }
+  pthread_mutex_unlock(&log_system.log_mutex);
+}
 
-    
-  if (log_system.count >= MAX_LOGS && log_system.head) {
-    SensorLog *old_head = log_system.head;
-    log_system.head = old_head->next;
-    if (log_system.head) {
-      log_system.head->prev = NULL;
-    } else {
-      log_system.tail = NULL;
-    }
+// Lists one sensor's readings in [from, to] and moves the cursor to the
+// first of them.
+void show_sensor_range(int sensor_id, long from, long to) {
+  pthread_mutex_lock(&log_system.log_mutex);
 
-        
-    if (log_system.current == old_head) {
-      log_system.current = log_system.head;
-    }
+  SensorIndex *index = find_sensor_index(sensor_id, 0);
+  int first = index ? sensor_lower_bound(index, (time_t)from) : 0;
+  int last = index ? sensor_lower_bound(index, (time_t)to + 1) : 0;
 
-    free(old_head);
-    log_system.count--;
+  printf("\n=== Sensor %03d: %d logs in range ===\n", sensor_id,
+         last > first ? last - first : 0);
+  for (int i = first; i < last && i < first + RANGE_DISPLAY_LIMIT; i++) {
+    int position = (int)(index->seqs[index->head + i] - log_system.first_seq);
+    SensorLog *log = log_at(position);
+    printf("[%d] %ld T=%.1f°C H=%.1f%% P=%.2fhPa V=%.2fm/s²\n", position + 1,
+           (long)log->timestamp, log->temperature, log->humidity, log->pressure,
+           log->vibration);
   }
-    
-  if (log_system.tail) {
-    log_system.tail->next = log;
-    log->prev = log_system.tail;
-    log_system.tail = log;
-  } else {
-        
-    log_system.head = log;
-    log_system.tail = log;
-    log_system.current = log;
+  if (last - first > RANGE_DISPLAY_LIMIT) {
+    printf("... %d more\n", last - first - RANGE_DISPLAY_LIMIT);
+  }
+  if (last > first) {
+    log_system.current = (int)(index->seqs[index->head + first] - log_system.first_seq);
   }
-
-  log_system.count++;
 
   pthread_mutex_unlock(&log_system.log_mutex);
 }
@@ -187,8 +1930,8 @@ void add_log_to_system(SensorLog *log) {
 void navigate_next() {
   pthread_mutex_lock(&log_system.log_mutex);
 
-  if (log_system.current && log_system.current->next) {
-    log_system.current = log_system.current->next;
+  if (log_system.current >= 0 && log_system.current + 1 < log_system.count) {
+    log_system.current++;
     printf("Navigated to next log.\n");
   } else {
     printf("Already at the most recent log.\n");
@@ -200,8 +1943,8 @@ void navigate_next() {
 void navigate_prev() {
   pthread_mutex_lock(&log_system.log_mutex);
 
-  if (log_system.current && log_system.current->prev) {
-    log_system.current = log_system.current->prev;
+  if (log_system.current > 0) {
+    log_system.current--;
     printf("Navigated to previous log.\n");
   } else {
     printf("Already at the oldest log.\n");
@@ -217,12 +1960,9 @@ void start_live_mode() {
   }
 
   log_system.live_mode = 1;
-  printf("Live mode activated. Sensor data streaming...\n");
-
-  // Create thread for generating sensor data
-  pthread_t sensor_thread;
-  pthread_create(&sensor_thread, NULL, sensor_data_generator, NULL);
-  pthread_detach(sensor_thread);
+  arm_sample_timer();
+  printf("Live mode activated. Sampling every %ld us...\n",
+         event_loop.sample_interval_us);
 }
 
 void stop_live_mode() {
@@ -232,27 +1972,31 @@ void stop_live_mode() {
   }
 
   log_system.live_mode = 0;
+  arm_sample_timer();
   printf("Live mode paused.\n");
 }
 
 void clear_all_logs() {
   pthread_mutex_lock(&log_system.log_mutex);
 
-  SensorLog *current = log_system.head;
-  while (current != NULL) {
-    SensorLog *next = current->next;
-    free(current);
-    current = next;
-  }
-
-  log_system.head = NULL;
-  log_system.tail = NULL;
-  log_system.current = NULL;
+  log_system.start = 0;
   log_system.count = 0;
+  log_system.current = -1;
+  reset_history();
+  reset_rollup_tier(&minute_tier);
+  reset_rollup_tier(&hour_tier);
+  reset_sensor_index();
+
+  // The journal writer truncates the segment before its next commit.
+  pthread_mutex_lock(&journal.mutex);
+  journal.pending_count = 0;
+  journal.truncate_requested = 1;
+  pthread_cond_signal(&journal.wake);
+  pthread_mutex_unlock(&journal.mutex);
 
   pthread_mutex_unlock(&log_system.log_mutex);
 
-  printf("All logs cleared. Memory freed.\n");
+  printf("All logs cleared.\n");
 }
 
 void display_current_log() {
@@ -260,15 +2004,15 @@ void display_current_log() {
 
   printf("\n=== Current Sensor Log ===\n");
 
-  if (log_system.current) {
-    struct tm *timeinfo = localtime(&log_system.current->timestamp);
-    printf("Log [Position: %d/%d]\n", get_log_position(log_system.current),
-           log_system.count);
-    printf("Sensor ID: %03d\n", log_system.current->sensor_id);
-    printf("Temperature: %.1f°C\n", log_system.current->temperature);
-    printf("Humidity: %.1f%%\n", log_system.current->humidity);
-    printf("Pressure: %.2f hPa\n", log_system.current->pressure);
-    printf("Vibration: %.2f m/s²\n", log_system.current->vibration);
+  if (log_system.current >= 0) {
+    SensorLog *log = log_at(log_system.current);
+    struct tm *timeinfo = localtime(&log->timestamp);
+    printf("Log [Position: %d/%d]\n", get_log_position(), log_system.count);
+    printf("Sensor ID: %03d\n", log->sensor_id);
+    printf("Temperature: %.1f°C\n", log->temperature);
+    printf("Humidity: %.1f%%\n", log->humidity);
+    printf("Pressure: %.2f hPa\n", log->pressure);
+    printf("Vibration: %.2f m/s²\n", log->vibration);
     printf("Timestamp: %s", asctime(timeinfo));
   } else {
     printf("No logs available.\n");
@@ -280,36 +2024,256 @@ void display_current_log() {
 void display_menu() {
   printf("\nCommands:\n");
   printf("(n) Next log | (p) Previous log | (y) Start live | (z) Pause live\n");
+  printf("(t T) Seek to time | (j K) Jump to position | (r ID T1 T2) Sensor time range\n");
+  printf("(a ID SECONDS) Aggregates | (h ID HOURS) Long-term rollups | (i US) Sampling interval\n");
   printf("(c) Clear logs | (s) Save and exit\n");
   if (log_system.live_mode) {
     printf("[LIVE MODE ACTIVE]\n");
   }
 }
 
-void *sensor_data_generator(void *arg) {
-  (void)arg; // Suppress unused parameter warning
-int sensor_id = 1;
-    
-  while (log_system.live_mode) {
-        
+// Arms the sampling timer at the current interval, or disarms it when
+// live mode is off. Changing the rate never spawns a thread.
+void arm_sample_timer() {
+  struct itimerspec spec;
+
+  memset(&spec, 0, sizeof(spec));
+  if (log_system.live_mode) {
+    spec.it_interval.tv_sec = event_loop.sample_interval_us / 1000000;
+    spec.it_interval.tv_nsec = (event_loop.sample_interval_us % 1000000) * 1000;
+    spec.it_value = spec.it_interval;
+  }
+  timerfd_settime(event_loop.timer_fd, 0, &spec, NULL);
+}
+
+void set_sample_interval(long interval_us) {
+  if (interval_us <= 0) {
+    printf("Sampling interval must be a positive number of microseconds.\n");
+    return;
+  }
+
+  event_loop.sample_interval_us = interval_us;
+  arm_sample_timer();
+  printf("Sampling interval set to %ld us (%.1f readings/sec).\n", interval_us,
+         1e6 / interval_us);
+}
+
+// Called once per timer wakeup; `ticks` is the number of expirations since
+// the last one, so a late wakeup catches up instead of losing samples.
+void sample_sensors(uint64_t ticks) {
+  int echo = event_loop.sample_interval_us >= ECHO_SAMPLE_INTERVAL_US;
+
+  if (ticks > MAX_SAMPLES_PER_TICK) {
+    ticks = MAX_SAMPLES_PER_TICK;
+  }
+
+  for (uint64_t t = 0; t < ticks; t++) {
+    int sensor_id = event_loop.next_sensor_id;
     float temp = 20.0 + (rand() % 100) / 10.0;
     float humidity = 30.0 + (rand() % 400) / 10.0;
     float pressure = 1000.0 + (rand() % 300) / 10.0;
     float vibration = (rand() % 50) / 100.0;
 
-    SensorLog *new_log =
+    SensorLog new_log =
         create_sensor_log(sensor_id, temp, humidity, pressure, vibration);
-    if (new_log) {
-      add_log_to_system(new_log);
-      printf(
-          "\n[NEW DATA] Sensor %03d: T=%.1f°C H=%.1f%% P=%.2fhPa V=%.2fm/s²\n",
-          sensor_id, temp, humidity, pressure, vibration);
+    if (publish_reading(&new_log)) {
+      if (echo) {
+        printf(
+            "\n[NEW DATA] Sensor %03d: T=%.1f°C H=%.1f%% P=%.2fhPa V=%.2fm/s²\n",
+            sensor_id, temp, humidity, pressure, vibration);
+      }
+    } else {
+      __atomic_fetch_add(&ingest_queue.dropped, 1, __ATOMIC_RELAXED);
     }
-sensor_id = (sensor_id % 10) + 1;
-sleep(2);
+    event_loop.next_sensor_id = (sensor_id % 10) + 1;
+  }
+}
+
+// Async-signal-safe: just wakes the event loop.
+void handle_shutdown_signal(int signal_number) {
+  uint64_t one = 1;
+  (void)signal_number;
+  if (write(event_loop.shutdown_fd, &one, sizeof(one)) < 0) {
+    // Nothing safe to do from a signal handler.
   }
+}
 
-  return NULL;
+void prompt() {
+  display_current_log();
+  display_menu();
+  printf("> ");
+  fflush(stdout);
+}
+
+void handle_command(char *line) {
+  char command;
+  long a = 0, b = 0, c = 0;
+
+  if (sscanf(line, " %c", &command) != 1) {
+    prompt();
+    return;
+  }
+  int args = sscanf(line, " %*c %ld %ld %ld", &a, &b, &c);
+
+  switch (command) {
+  case 'n':
+    navigate_next();
+    break;
+  case 'p':
+    navigate_prev();
+    break;
+  case 'y':
+    start_live_mode();
+    break;
+  case 'z':
+    stop_live_mode();
+    break;
+  case 'c':
+    clear_all_logs();
+    break;
+  case 'a':
+    if (args == 2) {
+      display_aggregates((int)a, (int)b);
+    } else {
+      printf("Usage: a SENSOR_ID SECONDS (0 for all sensors / all history)\n");
+    }
+    break;
+  case 't':
+    if (args == 1) {
+      seek_to_time(a);
+    } else {
+      printf("Usage: t UNIX_SECONDS\n");
+    }
+    break;
+  case 'j':
+    if (args == 1) {
+      jump_to_position((int)a);
+    } else {
+      printf("Usage: j POSITION\n");
+    }
+    break;
+  case 'r':
+    if (args == 3) {
+      show_sensor_range((int)a, b, c);
+    } else {
+      printf("Usage: r SENSOR_ID FROM TO (Unix seconds)\n");
+    }
+    break;
+  case 'h':
+    if (args == 2) {
+      display_long_term((int)a, (int)b);
+    } else {
+      printf("Usage: h SENSOR_ID HOURS (0 for all sensors / all history)\n");
+    }
+    break;
+  case 'i':
+    if (args == 1) {
+      set_sample_interval(a);
+    } else {
+      printf("Usage: i MICROSECONDS\n");
+    }
+    break;
+  case 's':
+    event_loop.running = 0;
+    return;
+  default:
+    printf("Invalid command. Please use n, p, y, z, t, j, r, a, h, i, c, or s.\n");
+  }
+
+  prompt();
+}
+
+// Reads whatever stdin has and runs every complete line. EOF acts like 's'.
+void read_commands() {
+  char chunk[COMMAND_BUFFER];
+  ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EINTR) {
+      event_loop.running = 0;
+    }
+    return;
+  }
+  if (n == 0) {
+    event_loop.running = 0;
+    return;
+  }
+
+  for (ssize_t i = 0; i < n && event_loop.running; i++) {
+    if (chunk[i] == '\n' || event_loop.line_length == COMMAND_BUFFER - 1) {
+      event_loop.line[event_loop.line_length] = '\0';
+      event_loop.line_length = 0;
+      handle_command(event_loop.line);
+    } else {
+      event_loop.line[event_loop.line_length++] = chunk[i];
+    }
+  }
+}
+
+int run_event_loop() {
+  struct epoll_event event, events[4];
+  struct sigaction action;
+
+  event_loop.epoll_fd = epoll_create1(0);
+  event_loop.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  event_loop.shutdown_fd = eventfd(0, EFD_NONBLOCK);
+  if (event_loop.epoll_fd < 0 || event_loop.timer_fd < 0 || event_loop.shutdown_fd < 0) {
+    printf("Error: Could not set up the event loop.\n");
+    return 1;
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_shutdown_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  event.events = EPOLLIN;
+  event.data.fd = event_loop.timer_fd;
+  epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, event_loop.timer_fd, &event);
+  event.data.fd = event_loop.shutdown_fd;
+  epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, event_loop.shutdown_fd, &event);
+  event.data.fd = STDIN_FILENO;
+  if (epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) != 0) {
+    // Regular files are always readable, so poll them on every pass.
+    event_loop.stdin_is_file = 1;
+  }
+
+  event_loop.running = 1;
+  prompt();
+
+  while (event_loop.running) {
+    int ready = epoll_wait(event_loop.epoll_fd, events, 4,
+                           event_loop.stdin_is_file ? 0 : -1);
+    if (ready < 0 && errno != EINTR)
+      break;
+
+    for (int i = 0; i < ready; i++) {
+      if (events[i].data.fd == event_loop.timer_fd) {
+        uint64_t ticks;
+        if (read(event_loop.timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks)) {
+          sample_sensors(ticks);
+        }
+      } else if (events[i].data.fd == event_loop.shutdown_fd) {
+        printf("\nShutdown requested.\n");
+        event_loop.running = 0;
+      } else {
+        read_commands();
+      }
+    }
+    if (event_loop.stdin_is_file && event_loop.running) {
+      read_commands();
+    }
+  }
+
+  log_system.live_mode = 0;
+  arm_sample_timer();
+  stop_ingest_consumer();
+  save_and_exit();
+
+  close(event_loop.timer_fd);
+  close(event_loop.shutdown_fd);
+  close(event_loop.epoll_fd);
+  return 0;
 }
 
 void save_and_exit() {
@@ -317,96 +2281,602 @@ void save_and_exit() {
     save_session_state();
     printf("System shutting down gracefully.\n");
     printf("Total logs in system: %d\n", log_system.count);
+    if (ingest_queue.dropped > 0) {
+        printf("Readings dropped (ingest queue full): %lu\n", ingest_queue.dropped);
+    }
+}
+
+uint32_t crc32(const void *data, size_t length) {
+  static uint32_t table[256];
+  static int table_ready = 0;
+  const unsigned char *bytes = (const unsigned char *)data;
+  uint32_t crc = 0xFFFFFFFFu;
+
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    table_ready = 1;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Serializes one block (header + payload) into `out` and returns its size.
+size_t encode_block(unsigned char *out, int type, const void *payload,
+                    int count, size_t length) {
+  BlockHeader header;
+
+  header.count = count;
+  header.type = type;
+  header.crc = crc32(payload, length);
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + sizeof(header), payload, length);
+  return sizeof(header) + length;
+}
+
+int write_all(int fd, const unsigned char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    data += written;
+    length -= written;
+  }
+  return 0;
+}
+
+int append_block(int fd, int type, const void *payload, int count,
+                 size_t length) {
+  unsigned char buffer[sizeof(BlockHeader) + SEGMENT_BLOCK_RECORDS * sizeof(DiskRecord)];
+  return write_all(fd, buffer, encode_block(buffer, type, payload, count, length));
+}
+
+size_t block_payload_length(const BlockHeader *block) {
+  if (block->type == BLOCK_CHECKPOINT)
+    return sizeof(CheckpointRecord);
+  if (block->type == BLOCK_ROLLUP)
+    return block->count * sizeof(DiskRollup);
+  return block->count * sizeof(DiskRecord);
+}
+
+// Writes every bucket of `tier`, oldest first, as rollup blocks.
+int append_rollup_tier(int fd, const RollupTier *tier) {
+  DiskRollup records[ROLLUP_BLOCK_BUCKETS];
+  int filled = 0;
+
+  memset(records, 0, sizeof(records));
+  for (int i = 0; i < tier->count; i++) {
+    const RollupBucket *bucket = &tier->buckets[(tier->start + i) % tier->capacity];
+    DiskRollup *record = &records[filled++];
+    record->start = bucket->start;
+    record->sensor_id = bucket->sensor_id;
+    record->count = bucket->count;
+    record->granularity = tier->granularity;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+      record->min[m] = bucket->min[m];
+      record->max[m] = bucket->max[m];
+      record->sum[m] = bucket->sum[m];
+      record->sum_sq[m] = bucket->sum_sq[m];
+    }
+    if (filled == ROLLUP_BLOCK_BUCKETS || i == tier->count - 1) {
+      if (append_block(fd, BLOCK_ROLLUP, records, filled, filled * sizeof(DiskRollup)) != 0)
+        return -1;
+      filled = 0;
+    }
+  }
+  return 0;
+}
+
+// Puts a saved bucket back into its tier. Buckets arrive in the order
+// append_rollup_tier wrote them, so fold_into_tier sees them in time order.
+// Caller must hold log_mutex.
+void restore_rollup(const DiskRollup *record) {
+  RollupTier *tier = record->granularity == hour_tier.granularity     ? &hour_tier
+                     : record->granularity == minute_tier.granularity ? &minute_tier
+                                                                      : NULL;
+  RollupBucket bucket;
+
+  if (!tier)
+    return;
+  bucket.sensor_id = record->sensor_id;
+  bucket.start = (time_t)record->start;
+  bucket.count = record->count;
+  for (int m = 0; m < METRIC_COUNT; m++) {
+    bucket.min[m] = record->min[m];
+    bucket.max[m] = record->max[m];
+    bucket.sum[m] = record->sum[m];
+    bucket.sum_sq[m] = record->sum_sq[m];
+  }
+  fold_into_tier(tier, &bucket);
+}
+
+// Takes ownership of an append-mode segment fd. Readings journaled before
+// start_journal (e.g. a legacy import) wait in `pending`.
+void open_journal(int fd) {
+  journal.fd = fd;
+  journal.pending_capacity = journal.batch_size * 2;
+  journal.writing_capacity = journal.pending_capacity;
+  journal.pending = (DiskRecord *)malloc(journal.pending_capacity * sizeof(DiskRecord));
+  journal.writing = (DiskRecord *)malloc(journal.writing_capacity * sizeof(DiskRecord));
+  if (!journal.pending || !journal.writing) {
+    printf("Error: Could not allocate journal buffers.\n");
+    exit(1);
+  }
+}
+
+// Producer side: a copy under a short critical section, never a syscall.
+void journal_append(const SensorLog *logs, int count) {
+  if (journal.fd < 0)
+    return;
+
+  pthread_mutex_lock(&journal.mutex);
+
+  if (journal.pending_count + count > journal.pending_capacity) {
+    // The writer is behind; grow rather than block or drop readings.
+    int capacity = journal.pending_capacity * 2;
+    while (capacity < journal.pending_count + count) {
+      capacity *= 2;
+    }
+    DiskRecord *grown = (DiskRecord *)realloc(journal.pending, capacity * sizeof(DiskRecord));
+    if (!grown) {
+      pthread_mutex_unlock(&journal.mutex);
+      return;
+    }
+    journal.pending = grown;
+    journal.pending_capacity = capacity;
+  }
+
+  for (int i = 0; i < count; i++) {
+    DiskRecord *record = &journal.pending[journal.pending_count++];
+    record->timestamp = logs[i].timestamp;
+    record->sensor_id = logs[i].sensor_id;
+    record->temperature = logs[i].temperature;
+    record->humidity = logs[i].humidity;
+    record->pressure = logs[i].pressure;
+    record->vibration = logs[i].vibration;
+    record->reserved = 0;
+  }
+
+  if (journal.pending_count >= journal.batch_size) {
+    pthread_cond_signal(&journal.wake);
+  }
+
+  pthread_mutex_unlock(&journal.mutex);
+}
+
+// Appends a whole batch as consecutive blocks with a single write().
+// Only the writer thread (or shutdown, after it has exited) calls this.
+void journal_commit(const DiskRecord *records, int count) {
+  int blocks = (count + SEGMENT_BLOCK_RECORDS - 1) / SEGMENT_BLOCK_RECORDS;
+  size_t needed = blocks * sizeof(BlockHeader) + count * sizeof(DiskRecord);
+  size_t length = 0;
+
+  if (needed > journal.scratch_size) {
+    unsigned char *grown = (unsigned char *)realloc(journal.scratch, needed);
+    if (!grown) {
+      printf("Warning: Could not journal %d readings.\n", count);
+      return;
+    }
+    journal.scratch = grown;
+    journal.scratch_size = needed;
+  }
+
+  for (int i = 0; i < count; i += SEGMENT_BLOCK_RECORDS) {
+    int n = count - i < SEGMENT_BLOCK_RECORDS ? count - i : SEGMENT_BLOCK_RECORDS;
+    length += encode_block(journal.scratch + length, BLOCK_DATA, records + i, n,
+                           n * sizeof(DiskRecord));
+  }
+
+  if (write_all(journal.fd, journal.scratch, length) != 0) {
+    printf("Warning: Could not append to %s\n", SESSION_FILE);
+  }
+}
+
+// Wakes when a batch fills up, the fsync interval elapses, or a clear or
+// shutdown is requested; then commits everything pending and syncs once.
+void *journal_writer(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&journal.mutex);
+  for (;;) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += journal.fsync_interval_ms / 1000;
+    deadline.tv_nsec += (journal.fsync_interval_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (journal.running && !journal.truncate_requested &&
+           journal.pending_count < journal.batch_size) {
+      if (journal.fsync_interval_ms <= 0) {
+        pthread_cond_wait(&journal.wake, &journal.mutex);
+      } else if (pthread_cond_timedwait(&journal.wake, &journal.mutex, &deadline) ==
+                 ETIMEDOUT) {
+        break;
+      }
+    }
+
+    int truncate = journal.truncate_requested;
+    int stopping = !journal.running;
+    int count = journal.pending_count;
+    DiskRecord *batch = journal.pending;
+    int batch_capacity = journal.pending_capacity;
+
+    journal.pending = journal.writing;
+    journal.pending_capacity = journal.writing_capacity;
+    journal.writing = batch;
+    journal.writing_capacity = batch_capacity;
+    journal.pending_count = 0;
+    journal.truncate_requested = 0;
+    pthread_mutex_unlock(&journal.mutex);
+
+    if (truncate && ftruncate(journal.fd, sizeof(SegmentHeader)) != 0) {
+      printf("Warning: Could not truncate %s\n", SESSION_FILE);
+    }
+    if (count > 0) {
+      journal_commit(batch, count);
+      fdatasync(journal.fd);
+      journal.commits++;
+    }
+    if (stopping)
+      break;
+
+    pthread_mutex_lock(&journal.mutex);
+  }
+
+  return NULL;
+}
+
+void start_journal() {
+  if (journal.fd < 0)
+    return;
+
+  journal.running = 1;
+  pthread_create(&journal.writer, NULL, journal_writer, NULL);
+}
+
+// Drains the writer, then appends a checkpoint recording the navigation
+// position and syncs it. Nothing after it needs replaying.
+void stop_journal(int32_t current_from_end) {
+  CheckpointRecord checkpoint = {current_from_end, 0};
+
+  if (journal.fd < 0)
+    return;
+
+  pthread_mutex_lock(&journal.mutex);
+  journal.running = 0;
+  pthread_cond_signal(&journal.wake);
+  pthread_mutex_unlock(&journal.mutex);
+  pthread_join(journal.writer, NULL);
+
+  if (append_block(journal.fd, BLOCK_CHECKPOINT, &checkpoint, 0, sizeof(checkpoint)) != 0) {
+    printf("Warning: Could not write session checkpoint.\n");
+  }
+  fdatasync(journal.fd);
+  close(journal.fd);
+  journal.fd = -1;
+
+  free(journal.pending);
+  free(journal.writing);
+  free(journal.scratch);
+  journal.pending = journal.writing = NULL;
+  journal.scratch = NULL;
+}
+
+// Creates (or truncates) a segment holding only the header. Returns an
+// append-mode fd.
+int create_segment(const char *path) {
+  SegmentHeader header = {SESSION_MAGIC, SESSION_VERSION, sizeof(DiskRecord),
+                          SEGMENT_BLOCK_RECORDS, 0};
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+
+  if (fd < 0)
+    return -1;
+  if (write_all(fd, (const unsigned char *)&header, sizeof(header)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
 }
 
 void save_session_state() {
-    FILE* file = fopen("session_state.txt", "w");
-    if (!file) {
+    if (journal.fd < 0) {
         printf("Error: Could not save session state.\n");
         return;
     }
-    
+
+    // Readings are already journaled; only the pending batch and a
+    // checkpoint with the navigation position remain.
     pthread_mutex_lock(&log_system.log_mutex);
-    
-    int current_pos = get_log_position(log_system.current);
-    fprintf(file, "%d %d\n", log_system.count, current_pos);
-    
-    
-    SensorLog* current = log_system.head;
-    while (current != NULL) {
-        fprintf(file, "%d %.2f %.2f %.2f %.2f %ld\n",
-                current->sensor_id,
-                current->temperature,
-                current->humidity,
-                current->pressure,
-                current->vibration,
-                current->timestamp);
-        current = current->next;
-    }
-    
+    int32_t current_from_end = log_system.current >= 0 ? log_system.count - log_system.current : 0;
     pthread_mutex_unlock(&log_system.log_mutex);
-    fclose(file);
-    printf("Session state saved to session_state.txt\n");
+
+    stop_journal(current_from_end);
+    printf("Session state saved to %s (%lu group commits this session)\n",
+           SESSION_FILE, journal.commits);
 }
 
-void load_session_state() {
-    FILE* file = fopen("session_state.txt", "r");
+// Rewrites the segment with only its newest `keep` readings (taken straight
+// from the mapped blocks) once it has grown well past what memory retains.
+// Of those, only the newest `unfolded` are still raw history; everything
+// older has been folded into the rollup tiers, which are written at that
+// point in the stream so the dropped readings survive as rollups. Returns -1,
+// leaving the existing segment in place, if any write fails.
+int compact_segment(const unsigned char *data, size_t size, long keep, long unfolded,
+                    int32_t current_from_end) {
+  const char *tmp_path = SESSION_FILE ".tmp";
+  CheckpointRecord checkpoint = {current_from_end, 0};
+  DiskRecord block[SEGMENT_BLOCK_RECORDS];
+  int fd = create_segment(tmp_path);
+  int filled = 0, rollups_written = 0, ok = 1;
+  long total = 0, skip, before_rollups = keep > unfolded ? keep - unfolded : 0;
+  size_t offset;
+
+  if (fd < 0) {
+    unlink(tmp_path);
+    return -1;
+  }
+
+  for (offset = sizeof(SegmentHeader); offset + sizeof(BlockHeader) <= size;) {
+    const BlockHeader *header = (const BlockHeader *)(data + offset);
+    if (header->type == BLOCK_DATA) {
+      total += header->count;
+    }
+    offset += sizeof(BlockHeader) + block_payload_length(header);
+  }
+  skip = total - keep;
+
+  for (offset = sizeof(SegmentHeader); ok && offset + sizeof(BlockHeader) <= size;) {
+    const BlockHeader *header = (const BlockHeader *)(data + offset);
+    const DiskRecord *records = (const DiskRecord *)(data + offset + sizeof(BlockHeader));
+    offset += sizeof(BlockHeader) + block_payload_length(header);
+    if (header->type != BLOCK_DATA) {
+      continue; // old checkpoints and rollups are superseded
+    }
+    for (uint32_t i = 0; ok && i < header->count; i++) {
+      if (skip > 0) {
+        skip--;
+        continue;
+      }
+      if (!rollups_written && before_rollups == 0) {
+        if (filled > 0) {
+          ok = append_block(fd, BLOCK_DATA, block, filled, filled * sizeof(DiskRecord)) == 0;
+          filled = 0;
+        }
+        ok = ok && append_rollup_tier(fd, &hour_tier) == 0 &&
+             append_rollup_tier(fd, &minute_tier) == 0;
+        rollups_written = 1;
+      }
+      before_rollups--;
+      block[filled++] = records[i];
+      if (ok && filled == SEGMENT_BLOCK_RECORDS) {
+        ok = append_block(fd, BLOCK_DATA, block, filled, filled * sizeof(DiskRecord)) == 0;
+        filled = 0;
+      }
+    }
+  }
+  if (ok && filled > 0) {
+    ok = append_block(fd, BLOCK_DATA, block, filled, filled * sizeof(DiskRecord)) == 0;
+  }
+  if (ok && !rollups_written) {
+    ok = append_rollup_tier(fd, &hour_tier) == 0 && append_rollup_tier(fd, &minute_tier) == 0;
+  }
+  ok = ok && append_block(fd, BLOCK_CHECKPOINT, &checkpoint, 0, sizeof(checkpoint)) == 0;
+  ok = ok && fdatasync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(tmp_path, SESSION_FILE) == 0;
+
+  if (!ok) {
+    unlink(tmp_path);
+    return -1;
+  }
+  printf("Compacted session segment from %ld to %ld readings (%d minute and %d hour "
+         "rollups kept).\n",
+         total, keep, minute_tier.count, hour_tier.count);
+  return 0;
+}
+
+// One-time migration from the old fprintf text format.
+void import_legacy_session() {
+    FILE* file = fopen(LEGACY_SESSION_FILE, "r");
     if (!file) {
-        printf("No previous session state found.\n");
         return;
     }
     
     int saved_count, saved_current_pos;
     if (fscanf(file, "%d %d\n", &saved_count, &saved_current_pos) != 2) {
-        printf("Error reading session state header.\n");
+        printf("Error reading legacy session header.\n");
         fclose(file);
         return;
     }
     
-    printf("Loading previous session: %d logs, position %d\n", saved_count, saved_current_pos);
+    printf("Importing legacy session: %d logs, position %d\n", saved_count, saved_current_pos);
     
     for (int i = 0; i < saved_count; i++) {
-        int sensor_id;
-        float temperature, humidity, pressure, vibration;
-        time_t timestamp;
+        SensorLog log;
         
         if (fscanf(file, "%d %f %f %f %f %ld\n",
-                   &sensor_id, &temperature, &humidity, &pressure, &vibration, &timestamp) == 6) {
-            
-            SensorLog* log = create_sensor_log(sensor_id, temperature, humidity, pressure, vibration);
-            if (log) {
-                log->timestamp = timestamp;
-                add_log_to_system(log);
-            }
+                   &log.sensor_id, &log.temperature, &log.humidity,
+                   &log.pressure, &log.vibration, &log.timestamp) == 6) {
+            add_log_to_system(&log);
         } else {
             printf("Error reading sensor log %d\n", i + 1);
             break;
         }
     }
     
-    if (saved_current_pos > 0 && saved_current_pos <= log_system.count) {
-        log_system.current = log_system.head;
-        for (int i = 1; i < saved_current_pos && log_system.current; i++) {
-            log_system.current = log_system.current->next;
-        }
+    int dropped = saved_count > log_system.capacity ? saved_count - log_system.capacity : 0;
+    if (saved_current_pos - dropped > 0 && saved_current_pos - dropped <= log_system.count) {
+        log_system.current = saved_current_pos - dropped - 1;
     }
     
     fclose(file);
-    printf("Session state loaded successfully.\n");
 }
 
+// Maps the segment read-only and copies its packed records straight into
+// the ring and history; there is no per-field parsing. Readings after the
+// last checkpoint were journaled but never cleanly saved, i.e. they are
+// what a crash would otherwise have lost. Leaves the segment open for the
+// journal, truncated after the last intact block.
+void load_session_state() {
+    int fd = open(SESSION_FILE, O_RDWR | O_APPEND);
+    struct stat st;
 
-int get_log_position(SensorLog *target) {
-  if (!target)
-    return 0;
+    if (fd < 0) {
+        fd = create_segment(SESSION_FILE);
+        if (fd < 0) {
+            printf("Warning: Could not create %s; readings will not persist.\n", SESSION_FILE);
+            return;
+        }
+        open_journal(fd);
+        import_legacy_session();
+        if (log_system.count == 0) {
+            printf("No previous session state found.\n");
+        }
+        return;
+    }
+
+    const SegmentHeader *header = NULL;
+    unsigned char *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SegmentHeader)) {
+        data = (unsigned char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        }
+    }
+    header = (const SegmentHeader *)data;
+    if (!header || header->magic != SESSION_MAGIC || header->version > SESSION_VERSION ||
+        header->record_size != sizeof(DiskRecord)) {
+        printf("Error: %s is not a version %d session segment; starting fresh.\n",
+               SESSION_FILE, SESSION_VERSION);
+        if (data) {
+            munmap(data, st.st_size);
+        }
+        close(fd);
+        fd = create_segment(SESSION_FILE);
+        if (fd >= 0) {
+            open_journal(fd);
+        }
+        return;
+    }
 
-  int position = 1;
-  SensorLog *current = log_system.head;
+    size_t size = st.st_size;
+    size_t offset = sizeof(SegmentHeader);
+    long total = 0, at_checkpoint = -1;
+    int32_t checkpoint_from_end = header->current_from_end;
+    int previous_type = BLOCK_DATA;
+
+    pthread_mutex_lock(&log_system.log_mutex);
+    while (offset + sizeof(BlockHeader) <= size) {
+        const BlockHeader *block = (const BlockHeader *)(data + offset);
+        const unsigned char *payload = data + offset + sizeof(BlockHeader);
+        size_t length = block_payload_length(block);
+
+        if ((block->type == BLOCK_DATA &&
+             (block->count == 0 || block->count > SEGMENT_BLOCK_RECORDS)) ||
+            (block->type == BLOCK_ROLLUP &&
+             (block->count == 0 || block->count > ROLLUP_BLOCK_BUCKETS)) ||
+            block->type > BLOCK_ROLLUP ||
+            offset + sizeof(BlockHeader) + length > size ||
+            crc32(payload, length) != block->crc) {
+            printf("Warning: Ignoring damaged session data after %ld readings.\n", total);
+            break;
+        }
+
+        if (block->type == BLOCK_CHECKPOINT) {
+            const CheckpointRecord *checkpoint = (const CheckpointRecord *)payload;
+            at_checkpoint = total;
+            checkpoint_from_end = checkpoint->current_from_end;
+        } else if (block->type == BLOCK_ROLLUP) {
+            // Saved rollups cover every reading before them, including
+            // those already replayed into history; the ring keeps them.
+            if (previous_type != BLOCK_ROLLUP) {
+                reset_history();
+                reset_rollup_tier(&minute_tier);
+                reset_rollup_tier(&hour_tier);
+            }
+            const DiskRollup *records = (const DiskRollup *)payload;
+            for (uint32_t i = 0; i < block->count; i++) {
+                restore_rollup(&records[i]);
+            }
+        } else {
+            const DiskRecord *records = (const DiskRecord *)payload;
+            for (uint32_t i = 0; i < block->count; i++) {
+                SensorLog log;
+                log.timestamp = records[i].timestamp;
+                log.sensor_id = records[i].sensor_id;
+                log.temperature = records[i].temperature;
+                log.humidity = records[i].humidity;
+                log.pressure = records[i].pressure;
+                log.vibration = records[i].vibration;
+                store_log(&log);
+            }
+            total += block->count;
+        }
+        previous_type = block->type;
+        offset += sizeof(BlockHeader) + length;
+    }
+
+    // The saved position counts back from the newest reading at checkpoint
+    // time; map it onto the ring, which may have replayed more since.
+    long checkpoint_total = at_checkpoint >= 0 ? at_checkpoint : total;
+    if (checkpoint_from_end > 0 && checkpoint_from_end <= checkpoint_total) {
+        long position = checkpoint_total - checkpoint_from_end - (total - log_system.count);
+        log_system.current = position > 0 ? position : 0;
+    }
+    int32_t current_from_end = log_system.current >= 0 ? log_system.count - log_system.current : 0;
+    pthread_mutex_unlock(&log_system.log_mutex);
+
+    printf("Loaded previous session: %ld readings, position %d/%d\n", total,
+           get_log_position(), log_system.count);
+    if (at_checkpoint >= 0 && total > at_checkpoint) {
+        printf("Recovered %ld readings journaled after the last checkpoint.\n",
+               total - at_checkpoint);
+    } else if (at_checkpoint < 0 && header->version > 1 && total > 0) {
+        printf("Recovered %ld readings from a session with no checkpoint.\n", total);
+    }
+
+    long keep = log_system.count > history.count ? log_system.count : history.count;
+    int compacted = 0;
+    if (total > SEGMENT_COMPACT_FACTOR * (long)(log_system.capacity > history.capacity
+                                                    ? log_system.capacity
+                                                    : history.capacity)) {
+        compacted = compact_segment(data, offset, keep, history.count, current_from_end) == 0;
+        if (!compacted) {
+            printf("Warning: Could not compact session segment; keeping the old one.\n");
+        }
+    }
+    if (compacted) {
+        munmap(data, size);
+        close(fd);
+        fd = open(SESSION_FILE, O_RDWR | O_APPEND);
+    } else {
+        munmap(data, size);
+        if (offset < size && ftruncate(fd, offset) != 0) {
+            printf("Warning: Could not drop damaged session tail.\n");
+        }
+    }
+
+    if (fd >= 0) {
+        open_journal(fd);
+    }
+}
 
-  while (current && current != target) {
-    current = current->next;
-    position++;
-  }
 
-  return current ? position : 0;
+// O(1): the ring stores readings in order, so the position is the index.
+int get_log_position() {
+  return log_system.current + 1;
 }
@@ -1,48 +1,337 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #define MAX_NAME_LENGTH 50
-#define MAX_NAMES 40
 #define SIMILARITY_THRESHOLD 3
+#define ARENA_INITIAL 4096
+#define INDEX_INITIAL 256
+#define LEVENSHTEIN_STACK_ROW 256 // longer names fall back to a heap row
+#define TRIGRAM_MASK 0xFFFFFF      // three bytes per trigram code
+#define TRIGRAM_DIGIT_BITS 12     // radix sort digit when building the index
+#define TRIGRAM_DIGIT_VALUES (1 << TRIGRAM_DIGIT_BITS)
+#define TRIGRAM_MAX_NAME 256       // longer queries skip the trigram filter
+#define TRIGRAM_STACK_CANDIDATES 1024
+#define BENCH_SCAN_QUERIES 10
+#define BENCH_TREE_QUERIES 200
+#define BATCH_WINDOW 65536 // names read, verified and written per round
+#define BATCH_CHUNK 256    // names a worker claims at a time
+#define MAX_READERS 256    // reader slots: the terminal plus batch workers
+#define RELOAD_EVENT_BUFFER 4096
+#define NAMES_FILE "authorized_names.txt"
+#define SNAPSHOT_FILE "authorized_names.idx"
+#define SNAPSHOT_MAGIC 0x58494341u // "ACIX"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 64          // sections start on a cache line
+#define AUDIT_LOG_FILE "access_log.txt"
+#define AUDIT_RING_SIZE 4096 // must be a power of two
+#define AUDIT_WAKE_THRESHOLD (AUDIT_RING_SIZE / 2)
+#define AUDIT_KEEP_FILES 3   // rotated logs kept: access_log.txt.1 .. .3
+#define DEFAULT_AUDIT_FLUSH_MS 200
+#define DEFAULT_AUDIT_MAX_BYTES (10L * 1024 * 1024)
 
-typedef struct BSTNode {
-    char name[MAX_NAME_LENGTH];
-    struct BSTNode* left;
-    struct BSTNode* right;
-} BSTNode;
+// One slot of the search array. The first 8 bytes of the name, packed
+// big-endian, decide most comparisons without touching the arena.
+typedef struct {
+    uint64_t prefix;
+    uint32_t offset; // into NameIndex.arena
+    uint32_t length;
+} NameSlot;
+
+// Authorized names, sorted and laid out in Eytzinger (breadth-first) order:
+// the children of slot k are 2k and 2k+1, so a search walks down one
+// contiguous array and each level costs one comparison. Names are stored
+// back to back in a single arena and referenced by offset.
+typedef struct {
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+    NameSlot* slots; // 1-based; slots[0] is unused
+    int count;
+} NameIndex;
+
+// BK-tree over the names for "Did you mean" lookups. Every child sits at
+// a known edit distance from its parent, so by the triangle inequality a
+// subtree can only hold a name within `radius` of the query if its edge
+// distance is within `radius` of the parent's distance. Nodes live in one
+// array and link by index; node 0 is the root.
+typedef struct {
+    uint32_t slot;         // Eytzinger slot of the name
+    uint32_t distance;     // to the parent
+    uint32_t first_child;  // 0 = none
+    uint32_t next_sibling; // 0 = none
+} BKNode;
+
+typedef struct {
+    BKNode* nodes;
+    int count;
+} BKTree;
+
+// Inverted index from byte trigram to every name containing it, in
+// compressed-row form: the names holding keys[i] are the Eytzinger slots
+// postings[starts[i] .. starts[i + 1]), in ascending order.
+typedef struct {
+    uint32_t* keys; // sorted trigram codes
+    uint32_t* starts;
+    uint32_t* postings;
+    int count;
+} TrigramIndex;
+
+// Everything a lookup reads. An index is immutable once built; a reload
+// builds a fresh one and publishes it in place of the old. Suggestions
+// compare folded names (see fold_name); exact matches use the originals.
+typedef struct {
+    NameIndex names;
+    char* folded_arena;
+    uint32_t* folded; // offset of slot k's folded name in folded_arena
+    BKTree bk_tree;
+    TrigramIndex trigrams;
+    int names_capacity; // slots allocated while loading
+    size_t folded_size; // bytes used in folded_arena
+    void* mapping;      // snapshot the arrays point into; NULL if built in memory
+    size_t mapping_size;
+} AccessIndex;
+
+enum {
+    SECTION_SLOTS,
+    SECTION_ARENA,
+    SECTION_FOLDED,
+    SECTION_FOLDED_ARENA,
+    SECTION_BK_NODES,
+    SECTION_TRIGRAM_KEYS,
+    SECTION_TRIGRAM_STARTS,
+    SECTION_POSTINGS,
+    SECTION_COUNT
+};
+
+typedef struct {
+    uint64_t offset; // from the start of the file
+    uint64_t size;
+} SnapshotSection;
+
+// Header of a compiled index (--compile). The sections are the arrays of
+// an AccessIndex byte for byte, in native byte order; everything in them
+// refers to other data by slot number or by offset into an arena, never
+// by address, so the file is used in place wherever it is mapped.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t name_count;
+    uint32_t bk_count;
+    uint32_t trigram_count;
+    uint32_t checksum; // CRC-32 of everything after the header
+    SnapshotSection sections[SECTION_COUNT];
+} SnapshotHeader;
 
 typedef struct {
     char name[MAX_NAME_LENGTH];
     int distance;
+    long visited; // BK-tree nodes compared, for --bench
 } NameMatch;
 
-BSTNode* root = NULL;
-FILE* log_file = NULL;
+typedef enum { ACCESS_GRANTED, ACCESS_SUGGEST, ACCESS_DENIED } AccessResult;
+
+typedef void (*ClosestMatchFn)(const AccessIndex* index, const char* input,
+                               NameMatch* best_match);
+
+// The current window of a --batch run. Workers are started once and wait
+// for each new window (`generation`); they claim BATCH_CHUNK lines at a
+// time through `next` and write only their own results, so the shared name
+// index is read without locks. The last worker to finish a window wakes
+// the reader.
+typedef struct {
+    char** lines;
+    AccessResult* results;
+    NameMatch* matches;
+    int count;
+    int next;
+    unsigned long generation;
+    int busy;     // workers still on the current window
+    int finished; // no more windows
+    pthread_mutex_t lock;
+    pthread_cond_t window_ready;
+    pthread_cond_t window_done;
+} BatchWork;
+
+typedef struct {
+    BatchWork* work;
+    int slot; // reader slot
+} BatchWorker;
+
+// Readers are identified by a fixed slot: 0 for the terminal, 1..N for
+// batch workers. An epoch of 0 means the slot is not reading.
+typedef struct {
+    unsigned long epoch;
+    char pad[64 - sizeof(unsigned long)]; // one slot per cache line
+} ReaderSlot;
+
+typedef struct {
+    int inotify_fd;
+    int wake_fd;
+    int running;
+    pthread_t thread;
+} ReloadWatcher;
+
+typedef struct {
+    unsigned long sequence;
+    time_t when;
+    char name[MAX_NAME_LENGTH];
+} AuditEntry;
 
-BSTNode* create_node(const char* name);
-BSTNode* insert_bst(BSTNode* node, const char* name);
-BSTNode* search_bst(BSTNode* node, const char* name);
-void load_authorized_names();
+// Denials are handed to a logger thread through a bounded lock-free ring
+// (multi-producer, single consumer), so disk latency never reaches the
+// door. A full ring drops the event and counts it; the writer merges runs
+// of the same name into one line and counts those as coalesced.
+typedef struct {
+    AuditEntry entries[AUDIT_RING_SIZE];
+    unsigned long enqueue_pos;
+    unsigned long dequeue_pos;
+    unsigned long dropped;
+    unsigned long coalesced;
+    unsigned long written;
+    int flush_interval_ms;
+    long max_bytes;
+    long file_bytes;
+    int wake_fd;
+    int wake_pending; // a producer has signalled wake_fd since the last drain
+    int running;
+    pthread_t thread;
+} AuditLogger;
+
+AccessIndex* current_index = NULL;
+unsigned long global_epoch = 1;
+ReaderSlot reader_epochs[MAX_READERS];
+ReloadWatcher reload = {-1, -1, 0, 0};
+AuditLogger audit = {.flush_interval_ms = DEFAULT_AUDIT_FLUSH_MS,
+                     .max_bytes = DEFAULT_AUDIT_MAX_BYTES,
+                     .wake_fd = -1};
+FILE* log_file = NULL; // owned by the audit thread once it is running
+
+uint64_t name_prefix(const char* name);
+int compare_slots(const void* a, const void* b);
+int fill_eytzinger(AccessIndex* index, const NameSlot* sorted, int n, int k, int next);
+int search_names(const AccessIndex* index, const char* name);
+int add_name(AccessIndex* index, const char* name);
+void build_name_index(AccessIndex* index);
+AccessIndex* load_index(const char* path, FILE* report);
+uint32_t crc32(const void* data, size_t length);
+int write_snapshot(const AccessIndex* index, const char* path);
+AccessIndex* load_snapshot(const char* path, FILE* report);
+int snapshot_contents_valid(const AccessIndex* index, uint64_t postings_size);
+int compile_snapshot(const char* path);
+AccessIndex* load_current_index(FILE* report, const char** source);
+void load_authorized_names(FILE* report);
+const AccessIndex* read_lock(int slot);
+void read_unlock(int slot);
+void publish_index(AccessIndex* index);
+void* reload_watcher(void* arg);
+void start_reload_watcher();
+void stop_reload_watcher();
 int levenshtein_distance(const char* s1, const char* s2);
-void find_closest_match(BSTNode* node, const char* input, NameMatch* best_match);
+int levenshtein_matrix(const char* s1, const char* s2);
+int levenshtein_bounded(const char* s1, const char* s2, int limit);
+int levenshtein_myers(const char* pattern, int m, const char* text, int n, int limit);
+int levenshtein_banded(const char* s1, int len1, const char* s2, int len2, int limit);
+const char* slot_name(const AccessIndex* index, int k);
+const char* folded_name(const AccessIndex* index, int k);
+uint32_t fold_code_point(uint32_t c);
+size_t fold_name(const char* name, char* out, size_t capacity);
+int build_folded_names(AccessIndex* index);
+int name_trigrams(const char* folded, uint32_t* out);
+int compare_codes(const void* a, const void* b);
+int sort_trigram_pairs(uint64_t* pairs, long count);
+int build_trigram_index(AccessIndex* index);
+int trigram_postings(const AccessIndex* index, uint32_t key, const uint32_t** postings);
+int trigram_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match);
+void bk_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match);
+void build_bk_tree(AccessIndex* index);
+void search_bk_tree(const AccessIndex* index, uint32_t node, const char* input,
+                    NameMatch* best_match);
+void find_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match);
+void scan_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match);
+void consider_match(const char* name, int distance, NameMatch* best_match);
+void random_name(char* name, unsigned int* seed);
+double time_strategy(const AccessIndex* index, ClosestMatchFn strategy,
+                     char (*queries)[MAX_NAME_LENGTH], int count,
+                     const NameMatch* expected, long* visited, int* mismatches);
+void run_benchmark();
+AccessResult check_access(const AccessIndex* index, const char* input_name,
+                          NameMatch* match);
 void verify_access(const char* input_name);
+void verify_window(BatchWorker* worker);
+void* batch_worker(void* arg);
+int run_batch(const char* path, int threads);
 void log_unauthorized_access(const char* name);
-void cleanup_bst(BSTNode* node);
+int open_audit_log();
+void rotate_audit_log();
+int drain_audit_log();
+void* audit_writer(void* arg);
+void start_audit_logger();
+void stop_audit_logger();
+void free_index(AccessIndex* index);
 int min(int a, int b, int c);
 
-int main() {
+int main(int argc, char* argv[]) {
+    const char* batch_path = NULL;
+    const char* compile_path = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            run_benchmark();
+            return 0;
+        } else if (strcmp(argv[i], "--compile") == 0) {
+            compile_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : SNAPSHOT_FILE;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-flush-ms") == 0 && i + 1 < argc) {
+            audit.flush_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-max-bytes") == 0 && i + 1 < argc) {
+            audit.max_bytes = atol(argv[++i]);
+        } else {
+            printf("Usage: %s [--bench] [--compile [OUT]] [--batch FILE|- [--threads N]] "
+                   "[--log-flush-ms MS] [--log-max-bytes N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (compile_path) {
+        return compile_snapshot(compile_path);
+    }
+
+    if (batch_path) {
+        if (threads <= 0) threads = 1;
+        return run_batch(batch_path, threads);
+    }
+
     printf("=== Smart Access Control System ===\n");
     printf("Loading authorized personnel database...\n");
 
-    log_file = fopen("access_log.txt", "a");
-    if (!log_file) {
+    if (audit.flush_interval_ms <= 0) audit.flush_interval_ms = DEFAULT_AUDIT_FLUSH_MS;
+    if (!open_audit_log()) {
         printf("Warning: Could not open log file\n");
     }
+    start_audit_logger();
 
-    load_authorized_names();
+    load_authorized_names(stdout);
+    start_reload_watcher();
 
     char input_name[MAX_NAME_LENGTH];
 
@@ -69,7 +358,12 @@ int main() {
         printf("\n");
     }
 
-    cleanup_bst(root);
+    stop_reload_watcher();
+    if (current_index) {
+        free_index(current_index);
+        current_index = NULL;
+    }
+    stop_audit_logger();
     if (log_file) {
         fclose(log_file);
     }
@@ -78,64 +372,565 @@ int main() {
     return 0;
 }
 
-BSTNode* create_node(const char* name) {
-    BSTNode* node = (BSTNode*)malloc(sizeof(BSTNode));
-    if (!node) return NULL;
+uint64_t name_prefix(const char* name) {
+    uint64_t prefix = 0;
+    int i = 0;
+
+    for (; i < 8 && name[i]; i++) {
+        prefix = (prefix << 8) | (unsigned char)name[i];
+    }
+    return prefix << (8 * (8 - i));
+}
+
+// Used by qsort: orders slots exactly like strcmp orders their index->names.
+static const char* sort_arena;
+
+int compare_slots(const void* a, const void* b) {
+    const NameSlot* x = (const NameSlot*)a;
+    const NameSlot* y = (const NameSlot*)b;
+
+    if (x->prefix != y->prefix) {
+        return x->prefix < y->prefix ? -1 : 1;
+    }
+    return strcmp(sort_arena + x->offset, sort_arena + y->offset);
+}
+
+// In-order walk of the implicit tree rooted at k, assigning sorted[next..]
+// to slots. Returns the next unassigned sorted index.
+int fill_eytzinger(AccessIndex* index, const NameSlot* sorted, int n, int k, int next) {
+    if (k > n) return next;
 
-    strcpy(node->name, name);
-    node->left = NULL;
-    node->right = NULL;
-    return node;
+    next = fill_eytzinger(index, sorted, n, 2 * k, next);
+    index->names.slots[k] = sorted[next++];
+    return fill_eytzinger(index, sorted, n, 2 * k + 1, next);
 }
 
-BSTNode* insert_bst(BSTNode* node, const char* name) {
-    if (node == NULL) {
-        return create_node(name);
+// Returns the slot holding `name`, or 0 if it is not authorized.
+int search_names(const AccessIndex* index, const char* name) {
+    uint64_t prefix = name_prefix(name);
+    int k = 1;
+
+    while (k <= index->names.count) {
+        const NameSlot* slot = &index->names.slots[k];
+        int cmp;
+
+        if (prefix != slot->prefix) {
+            cmp = prefix < slot->prefix ? -1 : 1;
+        } else {
+            cmp = strcmp(name, index->names.arena + slot->offset);
+            if (cmp == 0) return k;
+        }
+        k = 2 * k + (cmp > 0);
     }
 
-    int cmp = strcmp(name, node->name);
-    if (cmp < 0) {
-        node->left = insert_bst(node->left, name);
-    } else if (cmp > 0) {
-        node->right = insert_bst(node->right, name);
+    return 0;
+}
+
+// Appends a name to the arena and an unsorted slot. build_name_index
+// must run before searching. Returns 0 when out of memory.
+int add_name(AccessIndex* index, const char* name) {
+    size_t length = strlen(name);
+
+    if (index->names.arena_size + length + 1 > index->names.arena_capacity) {
+        size_t grown_capacity = index->names.arena_capacity ? index->names.arena_capacity * 2 : ARENA_INITIAL;
+        while (grown_capacity < index->names.arena_size + length + 1) {
+            grown_capacity *= 2;
+        }
+        char* grown = (char*)realloc(index->names.arena, grown_capacity);
+        if (!grown) return 0;
+        index->names.arena = grown;
+        index->names.arena_capacity = grown_capacity;
+    }
+    if (index->names.count == index->names_capacity) {
+        int grown_capacity = index->names_capacity ? index->names_capacity * 2 : INDEX_INITIAL;
+        NameSlot* grown = (NameSlot*)realloc(index->names.slots, grown_capacity * sizeof(NameSlot));
+        if (!grown) return 0;
+        index->names.slots = grown;
+        index->names_capacity = grown_capacity;
     }
 
-    return node;
+    memcpy(index->names.arena + index->names.arena_size, name, length + 1);
+    index->names.slots[index->names.count].prefix = name_prefix(name);
+    index->names.slots[index->names.count].offset = (uint32_t)index->names.arena_size;
+    index->names.slots[index->names.count].length = (uint32_t)length;
+    index->names.arena_size += length + 1;
+    index->names.count++;
+    return 1;
 }
 
-BSTNode* search_bst(BSTNode* node, const char* name) {
-    if (node == NULL || strcmp(name, node->name) == 0) {
-        return node;
+// Sorts and deduplicates the added names, lays them out in Eytzinger
+// order and builds the BK-tree.
+void build_name_index(AccessIndex* index) {
+    NameSlot* sorted = index->names.slots;
+    int count = index->names.count;
+
+    sort_arena = index->names.arena;
+    qsort(sorted, count, sizeof(NameSlot), compare_slots);
+
+    // Drop duplicates; the arena keeps their bytes but nothing points at them.
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || compare_slots(&sorted[unique - 1], &sorted[i]) != 0) {
+            sorted[unique++] = sorted[i];
+        }
     }
 
-    if (strcmp(name, node->name) < 0) {
-        return search_bst(node->left, name);
+    index->names.slots = (NameSlot*)malloc((unique + 1) * sizeof(NameSlot));
+    index->names.count = 0;
+    index->names_capacity = 0;
+    if (!index->names.slots) {
+        printf("Error: Out of memory loading names\n");
+        free(sorted);
+        return;
     }
+    index->names.count = unique;
+    fill_eytzinger(index, sorted, unique, 1, 0);
+    free(sorted);
 
-    return search_bst(node->right, name);
+    if (!build_folded_names(index) || !build_trigram_index(index)) {
+        printf("Error: Out of memory indexing names\n");
+    }
+    build_bk_tree(index);
 }
 
-void load_authorized_names() {
-    FILE* file = fopen("authorized_names.txt", "r");
+// Builds a fresh index from `path`. Status and errors go to `report`, so
+// batch mode can keep stdout clean. Returns NULL if the file cannot be
+// read, leaving any published index in place.
+AccessIndex* load_index(const char* path, FILE* report) {
+    FILE* file = fopen(path, "r");
     if (!file) {
-        printf("Error: Could not open authorized_names.txt\n");
-        return;
+        fprintf(report, "Error: Could not open %s\n", path);
+        return NULL;
+    }
+
+    AccessIndex* index = (AccessIndex*)calloc(1, sizeof(AccessIndex));
+    if (!index) {
+        fclose(file);
+        return NULL;
     }
 
     char name[MAX_NAME_LENGTH];
-    int count = 0;
 
-    while (fgets(name, sizeof(name), file) && count < MAX_NAMES) {
+    while (fgets(name, sizeof(name), file)) {
         name[strcspn(name, "\n")] = 0;
 
-        if (strlen(name) > 0) {
-            root = insert_bst(root, name);
-            count++;
+        if (strlen(name) > 0 && !add_name(index, name)) {
+            fprintf(report, "Error: Out of memory loading names\n");
+            break;
         }
     }
-
     fclose(file);
-    printf("Loaded %d authorized personnel names\n", count);
+
+    build_name_index(index);
+    return index;
+}
+
+// CRC-32, eight bytes per step (slicing-by-8): table[j][b] is the CRC of
+// byte b followed by j zero bytes, so the eight lookups are independent.
+// Checking a large snapshot at startup is dominated by this loop.
+uint32_t crc32(const void* data, size_t length) {
+    static uint32_t table[8][256];
+    static int table_ready = 0;
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int j = 1; j < 8; j++) {
+                table[j][i] = table[0][table[j - 1][i] & 0xFF] ^ (table[j - 1][i] >> 8);
+            }
+        }
+        table_ready = 1;
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint32_t low = crc ^ (bytes[i] | bytes[i + 1] << 8 | bytes[i + 2] << 16 |
+                              (uint32_t)bytes[i + 3] << 24);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][bytes[i + 4]] ^ table[2][bytes[i + 5]] ^
+              table[1][bytes[i + 6]] ^ table[0][bytes[i + 7]];
+    }
+    for (; i < length; i++) {
+        crc = table[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Writes `index` as a snapshot. The image goes to a temporary file that is
+// renamed over `path`, so a running terminal never maps a partial file.
+int write_snapshot(const AccessIndex* index, const char* path) {
+    SnapshotHeader header;
+    const void* data[SECTION_COUNT];
+    int count = index->names.count;
+    int keys = index->trigrams.count;
+
+    if (!index->names.slots || !index->folded || !index->trigrams.starts ||
+        (count > 0 && !index->bk_tree.nodes)) {
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.name_count = (uint32_t)count;
+    header.bk_count = (uint32_t)index->bk_tree.count;
+    header.trigram_count = (uint32_t)keys;
+
+    data[SECTION_SLOTS] = index->names.slots;
+    header.sections[SECTION_SLOTS].size = (count + 1) * sizeof(NameSlot);
+    data[SECTION_ARENA] = index->names.arena;
+    header.sections[SECTION_ARENA].size = index->names.arena_size;
+    data[SECTION_FOLDED] = index->folded;
+    header.sections[SECTION_FOLDED].size = (count + 1) * sizeof(uint32_t);
+    data[SECTION_FOLDED_ARENA] = index->folded_arena;
+    header.sections[SECTION_FOLDED_ARENA].size = index->folded_size;
+    data[SECTION_BK_NODES] = index->bk_tree.nodes;
+    header.sections[SECTION_BK_NODES].size = index->bk_tree.count * sizeof(BKNode);
+    data[SECTION_TRIGRAM_KEYS] = index->trigrams.keys;
+    header.sections[SECTION_TRIGRAM_KEYS].size = keys * sizeof(uint32_t);
+    data[SECTION_TRIGRAM_STARTS] = index->trigrams.starts;
+    header.sections[SECTION_TRIGRAM_STARTS].size = (keys + 1) * sizeof(uint32_t);
+    data[SECTION_POSTINGS] = index->trigrams.postings;
+    header.sections[SECTION_POSTINGS].size = index->trigrams.starts[keys] * sizeof(uint32_t);
+
+    uint64_t total = sizeof(SnapshotHeader);
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        total = (total + SNAPSHOT_ALIGN - 1) & ~(uint64_t)(SNAPSHOT_ALIGN - 1);
+        header.sections[i].offset = total;
+        total += header.sections[i].size;
+    }
+
+    unsigned char* image = (unsigned char*)calloc(1, total);
+    if (!image) return 0;
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (header.sections[i].size > 0) {
+            memcpy(image + header.sections[i].offset, data[i], header.sections[i].size);
+        }
+    }
+    header.checksum = crc32(image + sizeof(SnapshotHeader), total - sizeof(SnapshotHeader));
+    memcpy(image, &header, sizeof(header));
+
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = fopen(temp_path, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        ok = fwrite(image, 1, total, file) == total;
+        ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(temp_path, path) == 0;
+        if (!ok) unlink(temp_path);
+    }
+    free(image);
+    return ok;
+}
+
+// Maps a snapshot and points a new index at it. Nothing is parsed or
+// copied: once the header and checksum check out, the arrays are used
+// straight from the page cache. Returns NULL if the file is missing or
+// does not check out.
+AccessIndex* load_snapshot(const char* path, FILE* report) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+
+    if (fd < 0) return NULL;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(SnapshotHeader)) {
+        fprintf(report, "Error: %s is truncated\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    unsigned char* base =
+        (unsigned char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(report, "Error: Could not map %s\n", path);
+        return NULL;
+    }
+
+    const SnapshotHeader* header = (const SnapshotHeader*)base;
+    uint64_t count = header->name_count;
+    uint64_t keys = header->trigram_count;
+    const SnapshotSection* sections = header->sections;
+    uint64_t expected[SECTION_COUNT] = {
+        (count + 1) * sizeof(NameSlot), sections[SECTION_ARENA].size,
+        (count + 1) * sizeof(uint32_t), sections[SECTION_FOLDED_ARENA].size,
+        header->bk_count * sizeof(BKNode), keys * sizeof(uint32_t),
+        (keys + 1) * sizeof(uint32_t), sections[SECTION_POSTINGS].size};
+    int valid = header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION &&
+                count <= INT_MAX && keys <= INT_MAX && header->bk_count <= count;
+    for (int i = 0; valid && i < SECTION_COUNT; i++) {
+        valid = sections[i].offset % SNAPSHOT_ALIGN == 0 && sections[i].offset <= size &&
+                sections[i].size <= size - sections[i].offset &&
+                sections[i].size == expected[i];
+    }
+    if (!valid || crc32(base + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) !=
+                      header->checksum) {
+        fprintf(report, "Error: %s is corrupt or from another version\n", path);
+        munmap(base, size);
+        return NULL;
+    }
+
+    AccessIndex* index = (AccessIndex*)calloc(1, sizeof(AccessIndex));
+    if (!index) {
+        munmap(base, size);
+        return NULL;
+    }
+    index->mapping = base;
+    index->mapping_size = size;
+    index->names.count = (int)count;
+    index->names.slots = (NameSlot*)(base + sections[SECTION_SLOTS].offset);
+    index->names.arena = (char*)(base + sections[SECTION_ARENA].offset);
+    index->names.arena_size = sections[SECTION_ARENA].size;
+    index->folded = (uint32_t*)(base + sections[SECTION_FOLDED].offset);
+    index->folded_arena = (char*)(base + sections[SECTION_FOLDED_ARENA].offset);
+    index->folded_size = sections[SECTION_FOLDED_ARENA].size;
+    index->bk_tree.nodes = (BKNode*)(base + sections[SECTION_BK_NODES].offset);
+    index->bk_tree.count = (int)header->bk_count;
+    index->trigrams.keys = (uint32_t*)(base + sections[SECTION_TRIGRAM_KEYS].offset);
+    index->trigrams.starts = (uint32_t*)(base + sections[SECTION_TRIGRAM_STARTS].offset);
+    index->trigrams.postings = (uint32_t*)(base + sections[SECTION_POSTINGS].offset);
+    index->trigrams.count = (int)keys;
+    if (!snapshot_contents_valid(index, sections[SECTION_POSTINGS].size)) {
+        fprintf(report, "Error: %s is corrupt or from another version\n", path);
+        free(index);
+        munmap(base, size);
+        return NULL;
+    }
+    return index;
+}
+
+// The checksum only proves the file is what the compiler wrote. Before any
+// lookup trusts it, check in one pass that every offset stays inside its
+// arena at a terminated string, every slot number names a slot, the
+// BK-tree is a tree (each node has one parent with a lower index, so no
+// search can loop) and posting lists tile the postings array.
+int snapshot_contents_valid(const AccessIndex* index, uint64_t postings_size) {
+    int count = index->names.count;
+    const NameSlot* slots = index->names.slots;
+    const BKNode* nodes = index->bk_tree.nodes;
+    const TrigramIndex* trigrams = &index->trigrams;
+
+    for (int k = 1; k <= count; k++) {
+        if (slots[k].offset >= index->names.arena_size ||
+            slots[k].length >= index->names.arena_size - slots[k].offset ||
+            index->names.arena[slots[k].offset + slots[k].length] != '\0' ||
+            index->folded[k] >= index->folded_size) {
+            return 0;
+        }
+    }
+    if (count > 0 && index->folded_arena[index->folded_size - 1] != '\0') return 0;
+
+    if (count > 0 && index->bk_tree.count == 0) return 0;
+    unsigned char* has_parent = (unsigned char*)calloc(index->bk_tree.count + 1, 1);
+    if (!has_parent) return 0;
+    int tree_valid = 1;
+    for (int i = 0; tree_valid && i < index->bk_tree.count; i++) {
+        uint32_t previous = UINT32_MAX;
+        tree_valid = nodes[i].slot >= 1 && nodes[i].slot <= (uint32_t)count;
+        // A child list runs from the newest child down, so it must strictly
+        // decrease while staying above its parent.
+        for (uint32_t child = nodes[i].first_child; tree_valid && child;
+             child = nodes[child].next_sibling) {
+            tree_valid = child > (uint32_t)i && child < previous &&
+                         child < (uint32_t)index->bk_tree.count && !has_parent[child];
+            if (tree_valid) has_parent[child] = 1;
+            previous = child;
+        }
+    }
+    free(has_parent);
+    if (!tree_valid) return 0;
+
+    uint32_t postings = trigrams->starts[trigrams->count];
+    if (trigrams->starts[0] != 0 || postings_size != (uint64_t)postings * sizeof(uint32_t)) {
+        return 0;
+    }
+    for (int i = 0; i < trigrams->count; i++) {
+        if (trigrams->starts[i] > trigrams->starts[i + 1] ||
+            (i > 0 && trigrams->keys[i] <= trigrams->keys[i - 1])) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < postings; i++) {
+        if (trigrams->postings[i] < 1 || trigrams->postings[i] > (uint32_t)count) return 0;
+    }
+    return 1;
+}
+
+int compile_snapshot(const char* path) {
+    struct timespec begin, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    AccessIndex* index = load_index(NAMES_FILE, stdout);
+    if (!index) return 1;
+
+    int ok = write_snapshot(index, path);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (ok) {
+        struct stat info;
+        double megabytes = stat(path, &info) == 0 ? info.st_size / (1024.0 * 1024.0) : 0;
+        printf("Compiled %d names into %s (%.1f MB) in %.1f ms\n", index->names.count, path,
+               megabytes,
+               (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6);
+    } else {
+        printf("Error: Could not write %s\n", path);
+    }
+    free_index(index);
+    return ok ? 0 : 1;
+}
+
+// Prefers the compiled snapshot unless the roster has been edited since it
+// was written; a missing or damaged snapshot falls back to the text file.
+AccessIndex* load_current_index(FILE* report, const char** source) {
+    struct stat names, snapshot;
+    AccessIndex* index = NULL;
+
+    if (stat(SNAPSHOT_FILE, &snapshot) == 0) {
+        if (stat(NAMES_FILE, &names) == 0 &&
+            (names.st_mtim.tv_sec > snapshot.st_mtim.tv_sec ||
+             (names.st_mtim.tv_sec == snapshot.st_mtim.tv_sec &&
+              names.st_mtim.tv_nsec > snapshot.st_mtim.tv_nsec))) {
+            fprintf(report, "Note: %s is older than %s; run --compile to refresh it\n",
+                    SNAPSHOT_FILE, NAMES_FILE);
+        } else {
+            index = load_snapshot(SNAPSHOT_FILE, report);
+        }
+    }
+    if (index) {
+        *source = SNAPSHOT_FILE;
+        return index;
+    }
+    *source = NAMES_FILE;
+    return load_index(NAMES_FILE, report);
+}
+
+void load_authorized_names(FILE* report) {
+    struct timespec begin, end;
+    const char* source;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    AccessIndex* index = load_current_index(report, &source);
+    if (!index) return;
+    int count = index->names.count;
+    publish_index(index);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fprintf(report, "Loaded %d authorized personnel names from %s in %.1f ms\n", count, source,
+            (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6);
+}
+
+// Readers announce the epoch they started in before loading the index
+// pointer and clear it when done; nothing else is needed on the read side.
+const AccessIndex* read_lock(int slot) {
+    __atomic_store_n(&reader_epochs[slot].epoch,
+                     __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&current_index, __ATOMIC_SEQ_CST);
+}
+
+void read_unlock(int slot) {
+    __atomic_store_n(&reader_epochs[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+// Swaps in `index`, waits until every reader that might still hold the
+// old one has finished, then frees it. Only the loader and the reload
+// thread publish, and never at the same time.
+void publish_index(AccessIndex* index) {
+    AccessIndex* old = __atomic_exchange_n(&current_index, index, __ATOMIC_SEQ_CST);
+    if (!old) return;
+
+    // A reader that announced an epoch older than `epoch` may have loaded
+    // `old`; one that announces later is guaranteed to see `index`.
+    unsigned long epoch = __atomic_add_fetch(&global_epoch, 1, __ATOMIC_SEQ_CST);
+    for (int slot = 0; slot < MAX_READERS; slot++) {
+        while (1) {
+            unsigned long seen = __atomic_load_n(&reader_epochs[slot].epoch, __ATOMIC_SEQ_CST);
+            if (seen == 0 || seen >= epoch) break;
+            sched_yield();
+        }
+    }
+
+    free_index(old);
+}
+
+// Watches the directory rather than the file, so editors that save by
+// writing a temporary file and renaming it over the roster are seen too.
+void* reload_watcher(void* arg) {
+    (void)arg;
+    char events[RELOAD_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {{reload.inotify_fd, POLLIN, 0}, {reload.wake_fd, POLLIN, 0}};
+
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+
+        ssize_t length = read(reload.inotify_fd, events, sizeof(events));
+        int changed = 0;
+        for (char* p = events; length > 0 && p < events + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            if (event->len > 0 && (strcmp(event->name, NAMES_FILE) == 0 ||
+                                   strcmp(event->name, SNAPSHOT_FILE) == 0)) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        if (!changed) continue;
+
+        struct timespec begin, end;
+        const char* source;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        AccessIndex* index = load_current_index(stdout, &source);
+        if (!index) continue;
+        int count = index->names.count;
+        publish_index(index);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        printf("\n[RELOAD] %d authorized names from %s in %.1f ms\n", count, source,
+               (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6);
+        fflush(stdout);
+    }
+
+    return NULL;
+}
+
+void start_reload_watcher() {
+    reload.inotify_fd = inotify_init1(IN_CLOEXEC);
+    reload.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (reload.inotify_fd < 0 || reload.wake_fd < 0 ||
+        inotify_add_watch(reload.inotify_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+        pthread_create(&reload.thread, NULL, reload_watcher, NULL) != 0) {
+        printf("Warning: Roster changes will not be picked up until restart\n");
+        if (reload.inotify_fd >= 0) close(reload.inotify_fd);
+        if (reload.wake_fd >= 0) close(reload.wake_fd);
+        reload.inotify_fd = reload.wake_fd = -1;
+        return;
+    }
+    reload.running = 1;
+}
+
+void stop_reload_watcher() {
+    uint64_t one = 1;
+
+    if (!reload.running) return;
+    if (write(reload.wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        pthread_cancel(reload.thread);
+    }
+    pthread_join(reload.thread, NULL);
+    close(reload.inotify_fd);
+    close(reload.wake_fd);
+    reload.running = 0;
 }
 
 int min(int a, int b, int c) {
@@ -146,6 +941,11 @@ int min(int a, int b, int c) {
 }
 
 int levenshtein_distance(const char* s1, const char* s2) {
+    return levenshtein_bounded(s1, s2, INT_MAX);
+}
+
+// The original full-matrix DP, kept as the --bench scan baseline.
+int levenshtein_matrix(const char* s1, const char* s2) {
     int len1 = strlen(s1);
     int len2 = strlen(s2);
 
@@ -175,59 +975,1075 @@ int levenshtein_distance(const char* s1, const char* s2) {
     return matrix[len1][len2];
 }
 
-void find_closest_match(BSTNode* node, const char* input, NameMatch* best_match) {
-    if (node == NULL) return;
+// Edit distance if it is at most `limit`, otherwise limit + 1. Names up
+// to 64 characters take the bit-parallel path; longer ones a banded DP.
+int levenshtein_bounded(const char* s1, const char* s2, int limit) {
+    int len1 = strlen(s1);
+    int len2 = strlen(s2);
 
-    int distance = levenshtein_distance(input, node->name);
-    if (distance < best_match->distance) {
+    if (len1 > len2) {
+        const char* swap = s1;
+        s1 = s2;
+        s2 = swap;
+        int swap_len = len1;
+        len1 = len2;
+        len2 = swap_len;
+    }
+    if (limit > len2) limit = len2;
+    if (len2 - len1 > limit) return limit + 1;
+
+    if (len1 <= 64) {
+        return levenshtein_myers(s1, len1, s2, len2, limit);
+    }
+    return levenshtein_banded(s1, len1, s2, len2, limit);
+}
+
+// Myers' bit-parallel algorithm (Hyyro's formulation for global distance):
+// one 64-bit word holds a whole DP column of the pattern, so each text
+// character costs a handful of word operations. The score can fall by at
+// most one per remaining text character, which gives the early exit.
+int levenshtein_myers(const char* pattern, int m, const char* text, int n, int limit) {
+    uint64_t peq[256];
+
+    if (m == 0) return n <= limit ? n : limit + 1;
+
+    // Only characters of the two strings are ever looked up, so clear
+    // just those instead of all 256 entries.
+    for (int i = 0; i < n; i++) peq[(unsigned char)text[i]] = 0;
+    for (int i = 0; i < m; i++) peq[(unsigned char)pattern[i]] = 0;
+    for (int i = 0; i < m; i++) peq[(unsigned char)pattern[i]] |= 1ULL << i;
+
+    uint64_t vp = ~0ULL, vn = 0;
+    uint64_t last = 1ULL << (m - 1);
+    int score = m;
+
+    for (int j = 0; j < n; j++) {
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t xv = eq | vn;
+        uint64_t xh = (((eq & vp) + vp) ^ vp) | eq;
+        uint64_t hp = vn | ~(xh | vp);
+        uint64_t hn = vp & xh;
+
+        if (hp & last) {
+            score++;
+        } else if (hn & last) {
+            score--;
+        }
+        if (score - (n - j - 1) > limit) return limit + 1;
+
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(xv | hp);
+        vn = hp & xv;
+    }
+
+    return score <= limit ? score : limit + 1;
+}
+
+// Two-row DP over the diagonal band |i - j| <= limit; cells outside the
+// band count as limit + 1. Stops as soon as a whole row exceeds the limit.
+// s1 is the shorter string.
+int levenshtein_banded(const char* s1, int len1, const char* s2, int len2, int limit) {
+    int stack_rows[2 * LEVENSHTEIN_STACK_ROW];
+    int* heap_rows = NULL;
+    int* prev = stack_rows;
+    int* curr = stack_rows + LEVENSHTEIN_STACK_ROW;
+    int over = limit + 1;
+
+    if (len1 + 1 > LEVENSHTEIN_STACK_ROW) {
+        heap_rows = (int*)malloc(2 * (len1 + 1) * sizeof(int));
+        if (!heap_rows) return over;
+        prev = heap_rows;
+        curr = heap_rows + len1 + 1;
+    }
+
+    for (int j = 0; j <= len1; j++) {
+        prev[j] = j <= limit ? j : over;
+    }
+
+    for (int i = 1; i <= len2; i++) {
+        int from = i - limit > 1 ? i - limit : 1;
+        int to = i + limit < len1 ? i + limit : len1;
+        int row_min = over;
+
+        curr[0] = i <= limit ? i : over;
+        if (from > 1) curr[from - 1] = over;
+        for (int j = from; j <= to; j++) {
+            int cost = s2[i - 1] == s1[j - 1] ? 0 : 1;
+            int value = min(prev[j - 1] + cost, prev[j] + 1, curr[j - 1] + 1);
+            if (value > over) value = over;
+            curr[j] = value;
+            if (value < row_min) row_min = value;
+        }
+        if (to < len1) curr[to + 1] = over;
+        if (curr[0] < row_min) row_min = curr[0];
+
+        if (row_min > limit) {
+            free(heap_rows);
+            return over;
+        }
+        int* swap = prev;
+        prev = curr;
+        curr = swap;
+    }
+
+    int distance = prev[len1];
+    free(heap_rows);
+    return distance <= limit ? distance : over;
+}
+
+const char* slot_name(const AccessIndex* index, int k) {
+    return index->names.arena + index->names.slots[k].offset;
+}
+
+const char* folded_name(const AccessIndex* index, int k) {
+    return index->folded_arena + index->folded[k];
+}
+
+// Lower-case mapping for ASCII, Latin-1, Latin Extended-A, Greek and
+// Cyrillic capitals. Every pair encodes to the same UTF-8 length, so
+// folding never grows a name.
+uint32_t fold_code_point(uint32_t c) {
+    if (c >= 'A' && c <= 'Z') return c + 32;
+    if (c < 0xC0) return c;
+    if (c <= 0xDE) return c == 0xD7 ? c : c + 32;
+    if ((c >= 0x100 && c <= 0x137) || (c >= 0x14A && c <= 0x177)) return c | 1;
+    if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) return c & 1 ? c + 1 : c;
+    if (c == 0x178) return 0xFF;
+    if (c >= 0x391 && c <= 0x3A9 && c != 0x3A2) return c + 32;
+    if (c >= 0x400 && c <= 0x40F) return c + 80;
+    if (c >= 0x410 && c <= 0x42F) return c + 32;
+    return c;
+}
+
+// Case-folds `name` and collapses each run of whitespace (including
+// U+00A0) into one space, trimming both ends. Bytes that are not valid
+// UTF-8 are copied through unchanged. Returns the folded length.
+size_t fold_name(const char* name, char* out, size_t capacity) {
+    const unsigned char* in = (const unsigned char*)name;
+    size_t length = 0;
+    int pending_space = 0;
+
+    while (*in && length + 4 < capacity) {
+        uint32_t c = *in;
+        int bytes = 1;
+
+        if (c >= 0xC2 && c <= 0xDF && (in[1] & 0xC0) == 0x80) {
+            c = ((c & 0x1F) << 6) | (in[1] & 0x3F);
+            bytes = 2;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f' ||
+            c == 0xA0) {
+            pending_space = length > 0;
+            in += bytes;
+            continue;
+        }
+        if (pending_space) {
+            out[length++] = ' ';
+            pending_space = 0;
+        }
+
+        if (bytes == 2) {
+            c = fold_code_point(c);
+            out[length++] = (char)(0xC0 | (c >> 6));
+            out[length++] = (char)(0x80 | (c & 0x3F));
+        } else {
+            out[length++] = (char)(c < 0x80 ? fold_code_point(c) : c);
+        }
+        in += bytes;
+    }
+
+    out[length] = 0;
+    return length;
+}
+
+int build_folded_names(AccessIndex* index) {
+    char folded[MAX_NAME_LENGTH + 4];
+    size_t size = 0;
+
+    index->folded = (uint32_t*)malloc((index->names.count + 1) * sizeof(uint32_t));
+    // Folding never lengthens a name, so the original arena size suffices.
+    index->folded_arena = (char*)malloc(index->names.arena_size + 1);
+    if (!index->folded || !index->folded_arena) return 0;
+
+    for (int k = 1; k <= index->names.count; k++) {
+        size_t length = fold_name(slot_name(index, k), folded, sizeof(folded));
+        memcpy(index->folded_arena + size, folded, length + 1);
+        index->folded[k] = (uint32_t)size;
+        size += length + 1;
+    }
+    index->folded_size = size;
+    return 1;
+}
+
+// Writes the distinct byte trigrams of "  " + folded + " " to `out`,
+// sorted, and returns how many there are. `out` needs strlen(folded) + 1
+// entries.
+int name_trigrams(const char* folded, uint32_t* out) {
+    const unsigned char* s = (const unsigned char*)folded;
+    uint32_t window = (' ' << 8) | ' ';
+    int count = 0;
+
+    for (size_t i = 0;; i++) {
+        unsigned char c = s[i] ? s[i] : ' ';
+        window = ((window << 8) | c) & TRIGRAM_MASK;
+        out[count++] = window;
+        if (!s[i]) break;
+    }
+
+    qsort(out, count, sizeof(uint32_t), compare_codes);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || out[unique - 1] != out[i]) out[unique++] = out[i];
+    }
+    return unique;
+}
+
+int compare_codes(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Stable LSD radix sort of (trigram << 32 | slot) pairs on the 24-bit
+// trigram, two 12-bit digits. Pairs arrive in slot order and stay so
+// within each trigram.
+int sort_trigram_pairs(uint64_t* pairs, long count) {
+    uint64_t* scratch = (uint64_t*)malloc(count * sizeof(uint64_t) + 1);
+    uint32_t* offsets = (uint32_t*)malloc(TRIGRAM_DIGIT_VALUES * sizeof(uint32_t));
+    if (!scratch || !offsets) {
+        free(scratch);
+        free(offsets);
+        return 0;
+    }
+
+    uint64_t* from = pairs;
+    uint64_t* to = scratch;
+    for (int shift = 32; shift < 56; shift += TRIGRAM_DIGIT_BITS) {
+        memset(offsets, 0, TRIGRAM_DIGIT_VALUES * sizeof(uint32_t));
+        for (long i = 0; i < count; i++) {
+            offsets[(from[i] >> shift) & (TRIGRAM_DIGIT_VALUES - 1)]++;
+        }
+        uint32_t position = 0;
+        for (int d = 0; d < TRIGRAM_DIGIT_VALUES; d++) {
+            uint32_t n = offsets[d];
+            offsets[d] = position;
+            position += n;
+        }
+        for (long i = 0; i < count; i++) {
+            to[offsets[(from[i] >> shift) & (TRIGRAM_DIGIT_VALUES - 1)]++] = from[i];
+        }
+        uint64_t* swap = from;
+        from = to;
+        to = swap;
+    }
+    // An even number of passes leaves the result back in `pairs`.
+
+    free(scratch);
+    free(offsets);
+    return 1;
+}
+
+// Collects one (trigram << 32 | slot) pair per distinct trigram of each
+// name and sorts them by trigram: runs of equal trigrams become the
+// posting lists, already in slot order. Time and memory follow the total
+// name length.
+int build_trigram_index(AccessIndex* index) {
+    TrigramIndex* trigrams = &index->trigrams;
+    uint32_t codes[MAX_NAME_LENGTH + 4];
+    long total = 0;
+
+    if (!index->folded) return 0;
+    for (int k = 1; k <= index->names.count; k++) {
+        total += strlen(folded_name(index, k)) + 1;
+    }
+
+    uint64_t* pairs = (uint64_t*)malloc(total * sizeof(uint64_t) + 1);
+    if (!pairs) return 0;
+    total = 0;
+    for (int k = 1; k <= index->names.count; k++) {
+        int n = name_trigrams(folded_name(index, k), codes);
+        for (int i = 0; i < n; i++) pairs[total++] = ((uint64_t)codes[i] << 32) | (uint32_t)k;
+    }
+    if (!sort_trigram_pairs(pairs, total)) {
+        free(pairs);
+        return 0;
+    }
+
+    int keys = 0;
+    for (long i = 0; i < total; i++) {
+        if (i == 0 || pairs[i] >> 32 != pairs[i - 1] >> 32) keys++;
+    }
+    trigrams->keys = (uint32_t*)malloc(keys * sizeof(uint32_t) + 1);
+    trigrams->starts = (uint32_t*)malloc((keys + 1) * sizeof(uint32_t));
+    trigrams->postings = (uint32_t*)malloc(total * sizeof(uint32_t) + 1);
+    if (!trigrams->keys || !trigrams->starts || !trigrams->postings) {
+        free(pairs);
+        return 0;
+    }
+
+    keys = 0;
+    for (long i = 0; i < total; i++) {
+        uint32_t code = (uint32_t)(pairs[i] >> 32);
+        if (i == 0 || code != trigrams->keys[keys - 1]) {
+            trigrams->keys[keys] = code;
+            trigrams->starts[keys++] = (uint32_t)i;
+        }
+        trigrams->postings[i] = (uint32_t)pairs[i];
+    }
+    trigrams->starts[keys] = (uint32_t)total;
+    trigrams->count = keys;
+
+    free(pairs);
+    return 1;
+}
+
+// Points `postings` at the names containing `key` (NULL if none); returns
+// their count.
+int trigram_postings(const AccessIndex* index, uint32_t key, const uint32_t** postings) {
+    const TrigramIndex* trigrams = &index->trigrams;
+    int lo = 0, hi = trigrams->count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (trigrams->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == trigrams->count || trigrams->keys[lo] != key) {
+        *postings = NULL;
+        return 0;
+    }
+
+    *postings = trigrams->postings + trigrams->starts[lo];
+    return trigrams->starts[lo + 1] - trigrams->starts[lo];
+}
+
+// Inserts names in Eytzinger order, which mixes the alphabet far better
+// than sorted order and keeps the tree shallow.
+void build_bk_tree(AccessIndex* index) {
+    free(index->bk_tree.nodes);
+    index->bk_tree.count = 0;
+    index->bk_tree.nodes = (BKNode*)malloc(index->names.count * sizeof(BKNode));
+    if (!index->bk_tree.nodes || index->names.count == 0) return;
+
+    index->bk_tree.nodes[0].slot = 1;
+    index->bk_tree.nodes[0].distance = 0;
+    index->bk_tree.nodes[0].first_child = 0;
+    index->bk_tree.nodes[0].next_sibling = 0;
+    index->bk_tree.count = 1;
+
+    for (int k = 2; k <= index->names.count; k++) {
+        const char* name = folded_name(index, k);
+        uint32_t node = 0;
+
+        while (1) {
+            uint32_t distance =
+                levenshtein_distance(name, folded_name(index, index->bk_tree.nodes[node].slot));
+            uint32_t child = index->bk_tree.nodes[node].first_child;
+
+            while (child && index->bk_tree.nodes[child].distance != distance) {
+                child = index->bk_tree.nodes[child].next_sibling;
+            }
+            if (child) {
+                node = child;
+                continue;
+            }
+
+            BKNode* added = &index->bk_tree.nodes[index->bk_tree.count];
+            added->slot = k;
+            added->distance = distance;
+            added->first_child = 0;
+            added->next_sibling = index->bk_tree.nodes[node].first_child;
+            index->bk_tree.nodes[node].first_child = index->bk_tree.count++;
+            break;
+        }
+    }
+}
+
+// Keeps the closest name within SIMILARITY_THRESHOLD; ties go to the
+// alphabetically first name so every search strategy agrees.
+void consider_match(const char* name, int distance, NameMatch* best_match) {
+    if (distance > SIMILARITY_THRESHOLD) return;
+    if (distance < best_match->distance ||
+        (distance == best_match->distance && strcmp(name, best_match->name) < 0)) {
         best_match->distance = distance;
-        strcpy(best_match->name, node->name);
+        strcpy(best_match->name, name);
+    }
+}
+
+// The search radius shrinks to the best distance found so far, so
+// children whose edge is closest to this node's distance are visited
+// first: they are the likeliest to hold a close match.
+void search_bk_tree(const AccessIndex* index, uint32_t node, const char* input,
+                    NameMatch* best_match) {
+    int slot = index->bk_tree.nodes[node].slot;
+    int radius = best_match->distance < SIMILARITY_THRESHOLD ? best_match->distance
+                                                              : SIMILARITY_THRESHOLD;
+    int max_edge = 0;
+
+    // Beyond max_edge + radius no child can qualify and the node itself is
+    // no match, so the exact distance is not needed.
+    for (uint32_t child = index->bk_tree.nodes[node].first_child; child;
+         child = index->bk_tree.nodes[child].next_sibling) {
+        if ((int)index->bk_tree.nodes[child].distance > max_edge) {
+            max_edge = index->bk_tree.nodes[child].distance;
+        }
     }
+    int distance = levenshtein_bounded(input, folded_name(index, slot), max_edge + radius);
+
+    best_match->visited++;
+    consider_match(slot_name(index, slot), distance, best_match);
 
-    find_closest_match(node->left, input, best_match);
-    find_closest_match(node->right, input, best_match);
+    for (int offset = 0; offset <= SIMILARITY_THRESHOLD; offset++) {
+        radius = best_match->distance < SIMILARITY_THRESHOLD ? best_match->distance
+                                                                  : SIMILARITY_THRESHOLD;
+        if (offset > radius) break;
+
+        for (uint32_t child = index->bk_tree.nodes[node].first_child; child;
+             child = index->bk_tree.nodes[child].next_sibling) {
+            int edge = index->bk_tree.nodes[child].distance;
+            if (edge == distance - offset || (offset > 0 && edge == distance + offset)) {
+                search_bk_tree(index, child, input, best_match);
+            }
+        }
+    }
 }
 
-void verify_access(const char* input_name) {
-    BSTNode* exact_match = search_bst(root, input_name);
+void bk_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match) {
+    if (index->bk_tree.count == 0) return;
+    search_bk_tree(index, 0, input, best_match);
+}
 
-    if (exact_match) {
-        printf("ACCESS GRANTED\n");
-        printf("Welcome, %s!\n", input_name);
-        return;
+// A name within k edits of the query shares at least D - 3k of the
+// query's D distinct trigrams, since one edit touches at most three. So
+// any 3k + 1 of the query's trigrams must include one the name has: the
+// union of the 3k + 1 shortest posting lists is a complete candidate set.
+// Returns 0 without searching when the bound is useless (D <= 3k).
+int trigram_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match) {
+    uint32_t codes[TRIGRAM_MAX_NAME + 1];
+    const uint32_t* lists[TRIGRAM_MAX_NAME + 1] = {0};
+    int lengths[TRIGRAM_MAX_NAME + 1];
+    uint32_t stack_candidates[TRIGRAM_STACK_CANDIDATES];
+    int needed = 3 * SIMILARITY_THRESHOLD + 1;
+
+    if (!index->trigrams.keys || strlen(input) >= TRIGRAM_MAX_NAME) return 0;
+
+    int distinct = name_trigrams(input, codes);
+    if (distinct < needed) return 0;
+
+    // Selection sort is plenty for a few dozen trigrams.
+    long total = 0;
+    for (int i = 0; i < distinct; i++) {
+        lengths[i] = trigram_postings(index, codes[i], &lists[i]);
+    }
+    for (int i = 0; i < needed; i++) {
+        int rarest = i;
+        for (int j = i + 1; j < distinct; j++) {
+            if (lengths[j] < lengths[rarest]) rarest = j;
+        }
+        int length = lengths[i];
+        const uint32_t* list = lists[i];
+        lengths[i] = lengths[rarest];
+        lists[i] = lists[rarest];
+        lengths[rarest] = length;
+        lists[rarest] = list;
+        total += lengths[i];
+    }
+
+    uint32_t* candidates = stack_candidates;
+    if (total > TRIGRAM_STACK_CANDIDATES) {
+        candidates = (uint32_t*)malloc(total * sizeof(uint32_t));
+        if (!candidates) return 0;
+    }
+    long count = 0;
+    for (int i = 0; i < needed; i++) {
+        if (lengths[i] == 0) continue; // no name has this trigram
+        memcpy(candidates + count, lists[i], lengths[i] * sizeof(uint32_t));
+        count += lengths[i];
+    }
+    qsort(candidates, count, sizeof(uint32_t), compare_codes);
+
+    for (long i = 0; i < count; i++) {
+        if (i > 0 && candidates[i] == candidates[i - 1]) continue;
+
+        int radius = best_match->distance < SIMILARITY_THRESHOLD ? best_match->distance
+                                                                  : SIMILARITY_THRESHOLD;
+        int k = candidates[i];
+        best_match->visited++;
+        consider_match(slot_name(index, k),
+                       levenshtein_bounded(input, folded_name(index, k), radius), best_match);
+    }
+
+    if (candidates != stack_candidates) free(candidates);
+    return 1;
+}
+
+// `input` must already be folded.
+void find_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match) {
+    if (!trigram_closest_match(index, input, best_match)) {
+        bk_closest_match(index, input, best_match);
+    }
+}
+
+// Reference implementation: the original lookup, comparing against every
+// name with the full-matrix DP.
+void scan_closest_match(const AccessIndex* index, const char* input, NameMatch* best_match) {
+    for (int k = 1; k <= index->names.count; k++) {
+        consider_match(slot_name(index, k),
+                       levenshtein_matrix(input, folded_name(index, k)), best_match);
+    }
+}
+
+// Pure lookup against the read-only index: no output, no logging.
+AccessResult check_access(const AccessIndex* index, const char* input_name,
+                          NameMatch* match) {
+    match->distance = 999;
+    match->name[0] = 0;
+    match->visited = 0;
+
+    if (search_names(index, input_name)) {
+        return ACCESS_GRANTED;
     }
 
+    size_t length = strlen(input_name);
+    char stack_folded[TRIGRAM_MAX_NAME];
+    char* folded = length < sizeof(stack_folded) ? stack_folded : (char*)malloc(length + 5);
+    if (!folded) return ACCESS_DENIED;
+    fold_name(input_name, folded, length < sizeof(stack_folded) ? sizeof(stack_folded)
+                                                                : length + 5);
+    find_closest_match(index, folded, match);
+    if (folded != stack_folded) free(folded);
+
+    if (match->distance <= SIMILARITY_THRESHOLD && strlen(match->name) > 0) {
+        return ACCESS_SUGGEST;
+    }
+    return ACCESS_DENIED;
+}
+
+void verify_access(const char* input_name) {
     NameMatch best_match;
-    best_match.distance = 999;
-    strcpy(best_match.name, "");
+    AccessResult result = ACCESS_DENIED;
 
-    find_closest_match(root, input_name, &best_match);
+    const AccessIndex* index = read_lock(0);
+    if (index) result = check_access(index, input_name, &best_match);
+    read_unlock(0);
 
-    if (best_match.distance <= SIMILARITY_THRESHOLD && strlen(best_match.name) > 0) {
+    switch (result) {
+    case ACCESS_GRANTED:
+        printf("ACCESS GRANTED\n");
+        printf("Welcome, %s!\n", input_name);
+        break;
+    case ACCESS_SUGGEST:
         printf("ACCESS DENIED\n");
         printf("Did you mean: %s?\n", best_match.name);
-    } else {
+        break;
+    case ACCESS_DENIED:
         printf("ACCESS DENIED\n");
         printf("Name not recognized. Access logged for review.\n");
         log_unauthorized_access(input_name);
+        break;
+    }
+}
+
+void verify_window(BatchWorker* worker) {
+    BatchWork* work = worker->work;
+
+    while (1) {
+        int first = __atomic_fetch_add(&work->next, BATCH_CHUNK, __ATOMIC_RELAXED);
+        if (first >= work->count) break;
+
+        int last = first + BATCH_CHUNK < work->count ? first + BATCH_CHUNK : work->count;
+        const AccessIndex* index = read_lock(worker->slot);
+        for (int i = first; i < last; i++) {
+            work->results[i] = check_access(index, work->lines[i], &work->matches[i]);
+        }
+        read_unlock(worker->slot);
+    }
+}
+
+void* batch_worker(void* arg) {
+    BatchWorker* worker = (BatchWorker*)arg;
+    BatchWork* work = worker->work;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&work->lock);
+    while (1) {
+        while (!work->finished && work->generation == seen) {
+            pthread_cond_wait(&work->window_ready, &work->lock);
+        }
+        if (work->finished) break;
+        seen = work->generation;
+        pthread_mutex_unlock(&work->lock);
+
+        verify_window(worker);
+
+        pthread_mutex_lock(&work->lock);
+        if (--work->busy == 0) pthread_cond_signal(&work->window_done);
+    }
+    pthread_mutex_unlock(&work->lock);
+    return NULL;
+}
+
+int run_batch(const char* path, int threads) {
+    FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!input) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return 1;
+    }
+
+    load_authorized_names(stderr);
+    if (!current_index) {
+        if (input != stdin) fclose(input);
+        return 1;
     }
+    if (threads > MAX_READERS - 1) threads = MAX_READERS - 1;
+
+    BatchWork work;
+    memset(&work, 0, sizeof(work));
+    pthread_mutex_init(&work.lock, NULL);
+    pthread_cond_init(&work.window_ready, NULL);
+    pthread_cond_init(&work.window_done, NULL);
+    pthread_t* workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    BatchWorker* slots = (BatchWorker*)malloc(threads * sizeof(BatchWorker));
+    work.lines = (char**)calloc(BATCH_WINDOW, sizeof(char*));
+    work.results = (AccessResult*)malloc(BATCH_WINDOW * sizeof(AccessResult));
+    work.matches = (NameMatch*)malloc(BATCH_WINDOW * sizeof(NameMatch));
+    size_t* capacities = (size_t*)calloc(BATCH_WINDOW, sizeof(size_t));
+    int status = 0, started = 0;
+
+    if (!workers || !slots || !work.lines || !work.results || !work.matches || !capacities) {
+        fprintf(stderr, "Error: Out of memory for batch verification\n");
+        status = 1;
+    }
+    for (int t = 0; status == 0 && t < threads; t++) {
+        slots[t].work = &work;
+        slots[t].slot = t + 1;
+        if (pthread_create(&workers[t], NULL, batch_worker, &slots[t]) != 0) break;
+        started++;
+    }
+
+    long totals[3] = {0, 0, 0};
+    long verified = 0, skipped = 0;
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    while (status == 0) {
+        // Line buffers are reused across windows; getline grows them.
+        int count = 0;
+        ssize_t length = 0;
+        while (count < BATCH_WINDOW) {
+            length = getline(&work.lines[count], &capacities[count], input);
+            if (length < 0) break;
+
+            char* line = work.lines[count];
+            line[strcspn(line, "\r\n")] = 0;
+            if (strlen(line) > 0) {
+                count++;
+            } else {
+                skipped++;
+            }
+        }
+        if (count == 0) break;
+
+        work.count = count;
+        work.next = 0;
+        if (started == 0) {
+            verify_window(&slots[0]);
+        } else {
+            pthread_mutex_lock(&work.lock);
+            work.busy = started;
+            work.generation++;
+            pthread_cond_broadcast(&work.window_ready);
+            while (work.busy > 0) {
+                pthread_cond_wait(&work.window_done, &work.lock);
+            }
+            pthread_mutex_unlock(&work.lock);
+        }
+
+        for (int i = 0; i < count; i++) {
+            switch (work.results[i]) {
+            case ACCESS_GRANTED:
+                printf("GRANTED\t%s\n", work.lines[i]);
+                break;
+            case ACCESS_SUGGEST:
+                printf("SUGGEST\t%s\t%s\t%d\n", work.lines[i], work.matches[i].name,
+                       work.matches[i].distance);
+                break;
+            case ACCESS_DENIED:
+                printf("DENIED\t%s\n", work.lines[i]);
+                break;
+            }
+            totals[work.results[i]]++;
+        }
+        verified += count;
+        if (length < 0) break;
+    }
+
+    pthread_mutex_lock(&work.lock);
+    work.finished = 1;
+    pthread_cond_broadcast(&work.window_ready);
+    pthread_mutex_unlock(&work.lock);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+
+    if (status == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fflush(stdout);
+        double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        fprintf(stderr, "Verified %ld names in %.3f s with %d threads (%.0f names/sec): "
+                        "%ld granted, %ld suggestions, %ld denied; %ld blank lines skipped\n",
+                verified, elapsed, started > 0 ? started : 1,
+                elapsed > 0 ? verified / elapsed : 0.0, totals[ACCESS_GRANTED],
+                totals[ACCESS_SUGGEST], totals[ACCESS_DENIED], skipped);
+    }
+
+    for (int i = 0; work.lines && i < BATCH_WINDOW; i++) {
+        free(work.lines[i]);
+    }
+    free(work.lines);
+    free(work.results);
+    free(work.matches);
+    free(capacities);
+    free(workers);
+    free(slots);
+    pthread_mutex_destroy(&work.lock);
+    pthread_cond_destroy(&work.window_ready);
+    pthread_cond_destroy(&work.window_done);
+    if (input != stdin) fclose(input);
+    free_index(current_index);
+    current_index = NULL;
+    return status;
 }
 
+// Request path: one copy into the ring, no I/O. Safe from any thread.
 void log_unauthorized_access(const char* name) {
-    if (log_file) {
-        time_t now = time(NULL);
-        char* timestamp = ctime(&now);
-        timestamp[strlen(timestamp) - 1] = 0;
+    unsigned long pos = __atomic_load_n(&audit.enqueue_pos, __ATOMIC_RELAXED);
+    AuditEntry* entry;
+
+    if (!audit.running) {
+        // No logger thread: fall back to writing synchronously.
+        if (log_file) {
+            time_t now = time(NULL);
+            char* timestamp = ctime(&now);
+            timestamp[strlen(timestamp) - 1] = 0;
+
+            fprintf(log_file, "[%s] UNAUTHORIZED ACCESS ATTEMPT: %s\n", timestamp, name);
+            fflush(log_file);
+        }
+        return;
+    }
+
+    while (1) {
+        entry = &audit.entries[pos & (AUDIT_RING_SIZE - 1)];
+        unsigned long seq = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+        long diff = (long)seq - (long)pos;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&audit.enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&audit.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&audit.enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    entry->when = time(NULL);
+    strncpy(entry->name, name, MAX_NAME_LENGTH - 1);
+    entry->name[MAX_NAME_LENGTH - 1] = 0;
+    __atomic_store_n(&entry->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    // Wake the writer early rather than let the ring fill up. Claims can
+    // skip past the threshold, so any backlog at or above it qualifies;
+    // the pending flag keeps that to one signal per drain.
+    int idle = 0;
+    if (pos - __atomic_load_n(&audit.dequeue_pos, __ATOMIC_RELAXED) >= AUDIT_WAKE_THRESHOLD &&
+        __atomic_compare_exchange_n(&audit.wake_pending, &idle, 1, 0, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+        if (write(audit.wake_fd, &one, sizeof(one)) < 0) {
+            // The periodic flush will pick the entries up anyway.
+        }
+    }
+}
+
+int open_audit_log() {
+    struct stat st;
+
+    log_file = fopen(AUDIT_LOG_FILE, "a");
+    if (!log_file) return 0;
+
+    audit.file_bytes = fstat(fileno(log_file), &st) == 0 ? st.st_size : 0;
+    return 1;
+}
+
+// access_log.txt -> .1 -> .2 ... up to AUDIT_KEEP_FILES, oldest discarded.
+void rotate_audit_log() {
+    char from[64], to[64];
+
+    fclose(log_file);
+    for (int i = AUDIT_KEEP_FILES - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", AUDIT_LOG_FILE, i);
+        snprintf(to, sizeof(to), "%s.%d", AUDIT_LOG_FILE, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", AUDIT_LOG_FILE);
+    rename(AUDIT_LOG_FILE, to);
+
+    if (!open_audit_log()) {
+        printf("Warning: Could not reopen %s after rotation\n", AUDIT_LOG_FILE);
+    }
+}
+
+// Writes everything queued so far as one buffered batch and flushes once.
+// Only the audit thread (or shutdown, after it has exited) calls this.
+// Returns the number of entries consumed.
+int drain_audit_log() {
+    static unsigned long reported_drops = 0;
+    time_t formatted_at = (time_t)-1;
+    char timestamp[32] = "";
+    char previous[MAX_NAME_LENGTH] = "";
+    int repeats = 0, consumed = 0;
+
+    while (1) {
+        unsigned long pos = audit.dequeue_pos;
+        AuditEntry* entry = &audit.entries[pos & (AUDIT_RING_SIZE - 1)];
+        int ready = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) == pos + 1;
+
+        // Close the current run when the name changes or the ring is empty.
+        if (repeats > 0 && (!ready || strcmp(entry->name, previous) != 0)) {
+            if (log_file) {
+                int length = repeats > 1
+                    ? fprintf(log_file, "[%s] UNAUTHORIZED ACCESS ATTEMPT: %s (x%d)\n",
+                              timestamp, previous, repeats)
+                    : fprintf(log_file, "[%s] UNAUTHORIZED ACCESS ATTEMPT: %s\n",
+                              timestamp, previous);
+                if (length > 0) audit.file_bytes += length;
+                if (audit.max_bytes > 0 && audit.file_bytes >= audit.max_bytes) {
+                    rotate_audit_log();
+                }
+            }
+            audit.written++;
+            audit.coalesced += repeats - 1;
+            repeats = 0;
+        }
+        if (!ready) break;
 
-        fprintf(log_file, "[%s] UNAUTHORIZED ACCESS ATTEMPT: %s\n", timestamp, name);
+        if (entry->when != formatted_at) {
+            struct tm local;
+            localtime_r(&entry->when, &local);
+            strftime(timestamp, sizeof(timestamp), "%a %b %e %H:%M:%S %Y", &local);
+            formatted_at = entry->when;
+        }
+        if (repeats == 0) strcpy(previous, entry->name);
+        repeats++;
+
+        __atomic_store_n(&entry->sequence, pos + AUDIT_RING_SIZE, __ATOMIC_RELEASE);
+        __atomic_store_n(&audit.dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+        consumed++;
+    }
+
+    unsigned long dropped = __atomic_load_n(&audit.dropped, __ATOMIC_RELAXED);
+    if (dropped > reported_drops && log_file) {
+        time_t now = time(NULL);
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(timestamp, sizeof(timestamp), "%a %b %e %H:%M:%S %Y", &local);
+        int length = fprintf(log_file, "[%s] AUDIT OVERLOAD: %lu events dropped\n", timestamp,
+                             dropped - reported_drops);
+        reported_drops = dropped;
+        if (length > 0) audit.file_bytes += length;
         fflush(log_file);
+        if (audit.max_bytes > 0 && audit.file_bytes >= audit.max_bytes) {
+            rotate_audit_log();
+        }
+    }
+
+    if (log_file && consumed > 0) fflush(log_file);
+    return consumed;
+}
+
+void* audit_writer(void* arg) {
+    (void)arg;
+    struct pollfd wake = {audit.wake_fd, POLLIN, 0};
+    uint64_t count;
+
+    while (__atomic_load_n(&audit.running, __ATOMIC_ACQUIRE)) {
+        if (poll(&wake, 1, audit.flush_interval_ms) > 0 &&
+            read(audit.wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            break;
+        }
+        __atomic_store_n(&audit.wake_pending, 0, __ATOMIC_RELAXED);
+        drain_audit_log();
+    }
+
+    return NULL;
+}
+
+void start_audit_logger() {
+    for (unsigned long i = 0; i < AUDIT_RING_SIZE; i++) {
+        audit.entries[i].sequence = i;
+    }
+    audit.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (audit.wake_fd < 0) return;
+
+    audit.running = 1;
+    if (pthread_create(&audit.thread, NULL, audit_writer, NULL) != 0) {
+        audit.running = 0;
+        close(audit.wake_fd);
+        audit.wake_fd = -1;
+    }
+}
+
+void stop_audit_logger() {
+    uint64_t one = 1;
+
+    if (!audit.running) return;
+    __atomic_store_n(&audit.running, 0, __ATOMIC_RELEASE);
+    if (write(audit.wake_fd, &one, sizeof(one)) < 0) {
+        // poll() times out on its own.
+    }
+    pthread_join(audit.thread, NULL);
+    drain_audit_log();
+    close(audit.wake_fd);
+
+    if (audit.dropped > 0 || audit.coalesced > 0) {
+        printf("Audit log: %lu lines written, %lu events coalesced, %lu dropped\n",
+               audit.written, audit.coalesced, audit.dropped);
+    }
+}
+
+void free_index(AccessIndex* index) {
+    if (!index) return;
+
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+        free(index);
+        return;
+    }
+    free(index->names.slots);
+    free(index->names.arena);
+    free(index->folded_arena);
+    free(index->folded);
+    free(index->bk_tree.nodes);
+    free(index->trigrams.keys);
+    free(index->trigrams.starts);
+    free(index->trigrams.postings);
+    free(index);
+}
+
+// "Firstname Lastname" from a small alphabet, 4-10 letters each.
+void random_name(char* name, unsigned int* seed) {
+    static const char letters[] = "aeioubcdfghklmnprstvz";
+    int length = 0;
+
+    for (int part = 0; part < 2; part++) {
+        int letters_in_part = 4 + rand_r(seed) % 7;
+        name[length++] = toupper(letters[rand_r(seed) % (sizeof(letters) - 1)]);
+        for (int i = 1; i < letters_in_part; i++) {
+            name[length++] = letters[rand_r(seed) % (sizeof(letters) - 1)];
+        }
+        if (part == 0) name[length++] = ' ';
     }
+    name[length] = 0;
 }
 
-void cleanup_bst(BSTNode* node) {
-    if (node == NULL) return;
+// Runs `queries` lookups with `strategy`, checking the first
+// BENCH_SCAN_QUERIES against `expected`. Returns microseconds per query.
+double time_strategy(const AccessIndex* index, ClosestMatchFn strategy,
+                     char (*queries)[MAX_NAME_LENGTH], int count,
+                     const NameMatch* expected, long* visited, int* mismatches) {
+    struct timespec begin, end;
+
+    *visited = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int q = 0; q < count; q++) {
+        NameMatch match = {"", 999, 0};
+        strategy(index, queries[q], &match);
+        *visited += match.visited;
+        if (expected && q < BENCH_SCAN_QUERIES &&
+            (expected[q].distance != match.distance ||
+             strcmp(expected[q].name, match.name) != 0)) {
+            (*mismatches)++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - begin.tv_sec) * 1e6 + (end.tv_nsec - begin.tv_nsec) / 1e3) / count;
+}
+
+// Times "Did you mean" lookups on synthetic rosters: the full scan, the
+// BK-tree alone, and the trigram prefilter (with its BK-tree fallback).
+// Queries are roster names with up to two random edits, so most have a
+// suggestion.
+void run_benchmark() {
+    static const int sizes[] = {1000, 100000, 1000000};
+    char name[MAX_NAME_LENGTH];
+    char (*queries)[MAX_NAME_LENGTH] = malloc(BENCH_TREE_QUERIES * sizeof(*queries));
+    unsigned int seed = 12345;
+
+    if (!queries) return;
+
+    printf("%-9s %10s %10s %10s %12s %12s\n", "Names", "Scan us", "BK us", "Trigram us",
+           "BK compared", "3gram compared");
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        AccessIndex* index = (AccessIndex*)calloc(1, sizeof(AccessIndex));
+        if (!index) break;
+        for (int i = 0; i < sizes[s]; i++) {
+            random_name(name, &seed);
+            if (!add_name(index, name)) break;
+        }
+        build_name_index(index);
+        if (index->names.count == 0) {
+            free_index(index);
+            break;
+        }
+
+        for (int q = 0; q < BENCH_TREE_QUERIES; q++) {
+            strcpy(name, slot_name(index, 1 + rand_r(&seed) % index->names.count));
+            int edits = rand_r(&seed) % 3;
+            for (int e = 0; e < edits; e++) {
+                int length = strlen(name);
+                name[rand_r(&seed) % length] = 'a' + rand_r(&seed) % 26;
+            }
+            fold_name(name, queries[q], MAX_NAME_LENGTH);
+        }
+
+        NameMatch scanned[BENCH_SCAN_QUERIES];
+        struct timespec begin, end;
+        int mismatches = 0;
+        long bk_visited, trigram_visited;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int q = 0; q < BENCH_SCAN_QUERIES; q++) {
+            scanned[q].distance = 999;
+            scanned[q].name[0] = 0;
+            scan_closest_match(index, queries[q], &scanned[q]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double scan_us = ((end.tv_sec - begin.tv_sec) * 1e6 +
+                          (end.tv_nsec - begin.tv_nsec) / 1e3) / BENCH_SCAN_QUERIES;
+        double bk_us = time_strategy(index, bk_closest_match, queries, BENCH_TREE_QUERIES,
+                                     scanned, &bk_visited, &mismatches);
+        double trigram_us = time_strategy(index, find_closest_match, queries,
+                                          BENCH_TREE_QUERIES, scanned, &trigram_visited,
+                                          &mismatches);
+
+        printf("%-9d %10.1f %10.1f %10.1f %11.1f%% %12.1f\n", index->names.count, scan_us,
+               bk_us, trigram_us, 100.0 * bk_visited / BENCH_TREE_QUERIES / index->names.count,
+               (double)trigram_visited / BENCH_TREE_QUERIES);
+        if (mismatches > 0) {
+            printf("Warning: %d lookups disagreed with the scan\n", mismatches);
+        }
+        free_index(index);
+    }
 
-    cleanup_bst(node->left);
-    cleanup_bst(node->right);
-    free(node);
+    free(queries);
 }
@@ -1,43 +1,659 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
-#define MAX_DEVICES 10
+#include "graph_snapshot.h"
 
-const char *devices[MAX_DEVICES] = {"D001", "D002", "D003", "D004",
-                                    "D005", "D006", "D007", "D008"};
+#define MAX_DEVICE_ID 64
+#define MAX_LINE 256
+#define NAME_ARENA_INITIAL 4096
+#define DEVICES_INITIAL 256
+#define EDGES_INITIAL 1024
+#define DISPLAY_MATRIX_LIMIT 16 // larger graphs print a summary instead
+#define EDGE_SEPARATORS " \t,\r\n"
+#define BITSET_MAX_DEVICES 32768 // 2 x 128 MB of rows at the limit
+#define REACH_PRINT_LIMIT 50
+#define MAX_THREADS 256
+#define POOL_DEQUE_INITIAL 64
+#define PARALLEL_CHUNK 4096    // devices per parallel_for task
+#define KAHN_LOCAL_BUFFER 256  // freed devices a worker batches per append
+#define TRIM_LOCAL_BUFFER 256  // trimmed devices a worker batches per append
+#define CUT_PRINT_LIMIT 20
+#define BENCH_MIN_LINKS 100000L
+#define DEFAULT_BENCH_MAX_LINKS 10000000L
+#define DEFAULT_GRAPH_FILE "devices.graph"
+#define LINK_LIST_INITIAL 4
+#define DEFAULT_CHURN_UPDATES 1000000L
+#define CHURN_LINKS 1000000L
 
-int adj_matrix[MAX_DEVICES][MAX_DEVICES] = {0};
-int device_count = 8;
+// Device IDs are stored back to back in one arena and looked up through an
+// open-addressing hash table of device numbers, so a fleet of any size
+// costs a few bytes per device beyond the names themselves. The layout is
+// the name sections of a graph snapshot, so a mapped one is used as is.
+typedef struct {
+  char *arena;
+  size_t arena_size;
+  size_t arena_capacity;
+  uint32_t *offsets; // device i's ID is at arena + offsets[i]
+  int count;
+  int capacity;
+  uint32_t *table; // device number + 1, 0 = empty
+  uint32_t table_mask;
+  int mapped; // arena, offsets and table point into `snapshot`
+} DeviceTable;
+
+// Links collected while loading, before the graph is built.
+typedef struct {
+  uint32_t *from;
+  uint32_t *to;
+  size_t count;
+  size_t capacity;
+} EdgeList;
+
+// Compressed sparse row form: the devices device i sends to are
+// out_targets[out_offsets[i] .. out_offsets[i + 1]), sorted and without
+// duplicates; in_offsets/in_sources hold the same links reversed. Memory
+// is proportional to the number of links, and both directions of a
+// neighbor query cost O(degree).
+typedef struct {
+  int device_count;
+  uint32_t edge_count;
+  uint32_t *out_offsets;
+  uint32_t *out_targets;
+  uint32_t *in_offsets;
+  uint32_t *in_sources;
+  int mapped; // the arrays point into `snapshot`
+} Graph;
+
+// Dense alternative for medium fleets: one bit per possible link, rows of
+// 64-bit words. Row i of out_rows has bit j set for a link i -> j; in_rows
+// is the transpose. Degrees are popcounts, common neighbors an AND of two
+// rows and a BFS step an OR of the frontier's rows, 64 devices per word.
+typedef struct {
+  int device_count;
+  int words; // per row
+  uint64_t *out_rows;
+  uint64_t *in_rows;
+} BitsetGraph;
+
+typedef void (*TaskFn)(void *arg);
+
+typedef struct {
+  TaskFn fn;
+  void *arg;
+} Task;
+
+// Work-stealing thread pool. Each worker owns a mutex-guarded deque: it
+// pushes and pops its own tasks at the tail, newest first, while idle
+// workers steal from the head of the others.
+typedef struct {
+  pthread_mutex_t lock;
+  Task *tasks;
+  int head;
+  int tail;
+  int capacity;
+} TaskDeque;
+
+typedef struct {
+  int workers;
+  TaskDeque *deques;
+  pthread_t *threads;
+  long queued;  // tasks sitting in deques
+  long pending; // submitted and not finished
+  int sleepers;
+  int shutdown;
+  unsigned next_deque; // round-robin target for submissions from outside
+  pthread_mutex_t idle_lock;
+  pthread_cond_t work_ready;
+  pthread_cond_t all_done;
+} ThreadPool;
+
+typedef void (*RangeFn)(int begin, int end, void *context);
+
+typedef struct {
+  RangeFn fn;
+  void *context;
+  int begin;
+  int end;
+} RangeTask;
+
+// One forward-backward subproblem: the devices of one color.
+typedef struct {
+  int *vertices;
+  int count;
+  int color;
+} SccTask;
+
+typedef struct {
+  int *component;      // SCC label per device: the ID of one member
+  int *color;          // subproblem of each unassigned device, -1 once assigned
+  unsigned char *mark; // 1 = reached forward, 2 = reached backward
+  int *in_left;        // trimming: links from untrimmed devices, self-loops aside
+  int *out_left;       // trimming: links to untrimmed devices
+  uint32_t *trimmed;   // trimming worklist, in the order devices were trimmed
+  int trim_begin;      // start of the current round in `trimmed`
+  int trim_count;
+  int next_color;
+  int count;
+  int failed;
+} SccState;
+
+typedef struct {
+  uint32_t *order;
+  int *remaining; // in-links not yet removed
+  int level_begin;
+  int placed;
+} KahnState;
+
+// Working state of parallel_cut_analysis. The undirected view is a CSR of
+// its own; `parent` is the union-find forest that groups devices into
+// connected components.
+typedef struct {
+  uint32_t *offsets;
+  uint32_t *neighbors;
+  int *parent;
+  int *component_start; // per root: where its slice of `stack` begins
+  int *discovered;      // DFS discovery time, 0 = not yet
+  int *low;
+  int *tree_parent;
+  unsigned char *parent_skipped; // the tree link back to the parent was passed over
+  uint32_t *cursor;
+  int *stack;
+  unsigned char *is_cut;
+  uint32_t *bridges;
+  int bridge_count;
+} CutState;
+
+// One end of a link in a per-device list. `twin` is the position of the
+// matching entry in the other device's list, so both halves of a link can
+// be removed in O(1) once it has been found.
+typedef struct {
+  uint32_t device;
+  uint32_t twin;
+} LinkEntry;
+
+typedef struct {
+  LinkEntry *entries;
+  uint32_t count;
+  uint32_t capacity;
+} LinkList;
+
+// Mutable form of the graph while updates stream in. Links live in
+// unsorted per-device lists; weakly connected components are circular
+// doubly linked member lists with a size per label, merged small into
+// large when a link joins two of them and split by a search from both
+// ends when the last link between two devices goes. Removed devices keep
+// their slot (and their name in the device table) until the next
+// sync_graph compacts them away.
+typedef struct {
+  int active;
+  int device_count; // slots, removed devices included
+  int capacity;
+  int alive_count;
+  uint64_t edge_count;
+  LinkList *out;
+  LinkList *in;
+  unsigned char *alive;
+  int *component;      // label per device, -1 once removed
+  int *next_member;    // circular member list of each component
+  int *prev_member;
+  int *component_size; // per label
+  int *free_labels;
+  int free_label_count;
+  int next_label;
+  int component_count;
+  uint32_t *seen; // split search: epoch = found from the first end, epoch + 1 from the second
+  uint32_t epoch;
+  int *queue; // both split searches, `capacity` devices each
+} DynamicGraph;
+
+// What an update stream did, by kind.
+typedef struct {
+  long links_added;
+  long links_removed;
+  long devices_joined;
+  long devices_left;
+  long unchanged; // link already present or absent, device already known or gone
+  long malformed;
+} UpdateCounts;
+
+GraphSnapshot snapshot = {0};
+DeviceTable devices = {0};
+EdgeList pending_edges = {0};
+Graph graph = {0};
+BitsetGraph bitset = {0};
+int use_bitset = 0;
+DynamicGraph dynamic = {0};
+ThreadPool pool;
+__thread int pool_worker = -1; // the calling thread's deque, -1 outside the pool
+SccState scc;
+KahnState kahn;
+CutState cuts;
+
+uint32_t hash_device_id(const char *device_id);
+const char *device_name(int index);
+int find_device_index(const char *device_id);
+int add_device(const char *device_id);
+int unshare_devices();
+void free_device_table(DeviceTable *table);
+int queue_link(uint32_t from, uint32_t to);
+int add_connection(const char *from, const char *to);
+int load_edge_list(const char *path);
+int compare_ids(const void *a, const void *b);
+int build_graph(int device_count);
+int has_connection(int from, int to);
+size_t graph_memory_bytes();
+void display_adjacency_matrix();
+void query_device_connections(const char *device_id);
+void free_graph();
+int open_graph_snapshot(const char *path);
+int compile_graph_snapshot(const char *edge_path, const char *out_path);
+int build_bitset_graph();
+void free_bitset_graph();
+int out_degree(int device);
+int in_degree(int device);
+int common_targets(int a, int b, uint64_t *result);
+int reachable_within(int source, int hops, uint64_t *visited);
+void print_device_set(const uint64_t *set, int limit);
+void query_common_targets(const char *first, const char *second);
+void query_reach(const char *device_id, int hops);
+int grow_zeroed(void **array, size_t old, size_t grown, size_t element_size);
+int dynamic_reserve(int count);
+int new_component(int v);
+void merge_components(int a, int b);
+int start_dynamic();
+void free_dynamic();
+int link_list_push(LinkList *list, uint32_t device, uint32_t twin);
+long find_link(int from, int to);
+void remove_link_at(int from, uint32_t position);
+void split_if_disconnected(int u, int v);
+int join_device(const char *device_id, int *joined);
+int insert_link(const char *from, const char *to);
+int delete_link(const char *from, const char *to);
+int leave_device(const char *device_id);
+int apply_update(char op, const char *first, const char *second, UpdateCounts *counts);
+void update_command(char op, const char *first, const char *second);
+int apply_update_stream(const char *path);
+void print_dynamic_stats();
+int sync_graph();
+void pool_submit(TaskFn fn, void *arg);
+int deque_push(TaskDeque *deque, Task task);
+int deque_pop(TaskDeque *deque, Task *task);
+int deque_steal(TaskDeque *deque, Task *task);
+void *pool_thread(void *arg);
+int pool_start(int workers);
+void pool_wait();
+void pool_stop();
+void run_range(void *arg);
+void parallel_for(int count, RangeFn fn, void *context);
+int trim_device(int v);
+void trim_flush(const uint32_t *local, int used);
+void trim_seed_range(int begin, int end, void *context);
+void trim_level_range(int begin, int end, void *context);
+int mark_reachable(int pivot, int color, int forward, unsigned char bit, uint32_t *queue);
+void submit_scc_task(int *vertices, int count);
+void fwbw_task(void *arg);
+int parallel_scc(int *component);
+int tarjan_scc(int *component);
+void kahn_seed_range(int begin, int end, void *context);
+void kahn_level_range(int begin, int end, void *context);
+void kahn_flush(const uint32_t *local, int used);
+int parallel_topological_order(uint32_t *order, int *remaining, int *levels);
+int find_cycle(const int *remaining, uint32_t *cycle);
+uint32_t merge_neighbors(int v, uint32_t *out);
+void undirected_degree_range(int begin, int end, void *context);
+void undirected_fill_range(int begin, int end, void *context);
+int find_root(int v);
+void union_roots(int a, int b);
+void union_range(int begin, int end, void *context);
+void root_range(int begin, int end, void *context);
+void cut_task(void *arg);
+int parallel_cut_analysis(unsigned char *is_cut, uint32_t *bridges, int *bridge_count);
+double elapsed_ms(const struct timespec *begin);
+void run_analytics(int threads);
+int same_partition(const int *a, const int *b, int n, int *map);
+uint64_t next_random(uint64_t *state);
+void generate_fleet(int devices_wanted, long links, int acyclic);
+void run_analytics_benchmark(long max_links, int max_threads);
+int check_components();
+void run_churn_benchmark(long updates);
+
+uint32_t hash_device_id(const char *device_id) {
+  return graph_hash_name(device_id);
+}
+
+const char *device_name(int index) {
+  return devices.arena + devices.offsets[index];
+}
 
 int find_device_index(const char *device_id) {
-  for (int i = 0; i < device_count; i++) {
-    if (strcmp(devices[i], device_id) == 0) {
-      return i;
+  if (!devices.table) {
+    return -1;
+  }
+
+  uint32_t bucket = hash_device_id(device_id) & devices.table_mask;
+  while (devices.table[bucket]) {
+    int index = devices.table[bucket] - 1;
+    if (strcmp(device_name(index), device_id) == 0) {
+      return index;
     }
+    bucket = (bucket + 1) & devices.table_mask;
   }
   return -1;
 }
 
-void add_connection(const char *from, const char *to) {
-  int from_idx = find_device_index(from);
-  int to_idx = find_device_index(to);
+// Returns the device's number, registering it if it is new, or -1 if out
+// of memory.
+int add_device(const char *device_id) {
+  int index = find_device_index(device_id);
+  if (index != -1) {
+    return index;
+  }
+  if (devices.mapped && !unshare_devices()) {
+    return -1;
+  }
+
+  size_t length = strlen(device_id);
+  if (devices.arena_size + length + 1 > devices.arena_capacity) {
+    size_t capacity = devices.arena_capacity ? devices.arena_capacity : NAME_ARENA_INITIAL;
+    while (devices.arena_size + length + 1 > capacity) {
+      capacity *= 2;
+    }
+    char *grown = (char *)realloc(devices.arena, capacity);
+    if (!grown) {
+      return -1;
+    }
+    devices.arena = grown;
+    devices.arena_capacity = capacity;
+  }
+
+  if (devices.count == devices.capacity) {
+    int capacity = devices.capacity ? devices.capacity * 2 : DEVICES_INITIAL;
+    uint32_t *offsets = (uint32_t *)realloc(devices.offsets, capacity * sizeof(uint32_t));
+    if (!offsets) {
+      return -1;
+    }
+    devices.offsets = offsets;
+    devices.capacity = capacity;
+
+    // Keep the hash table at most half full.
+    uint32_t table_size = 2 * (uint32_t)capacity;
+    uint32_t *table = (uint32_t *)calloc(table_size, sizeof(uint32_t));
+    if (!table) {
+      return -1;
+    }
+    free(devices.table);
+    devices.table = table;
+    devices.table_mask = table_size - 1;
+    for (int i = 0; i < devices.count; i++) {
+      uint32_t bucket = hash_device_id(device_name(i)) & devices.table_mask;
+      while (devices.table[bucket]) {
+        bucket = (bucket + 1) & devices.table_mask;
+      }
+      devices.table[bucket] = i + 1;
+    }
+  }
+
+  memcpy(devices.arena + devices.arena_size, device_id, length + 1);
+  devices.offsets[devices.count] = (uint32_t)devices.arena_size;
+  devices.arena_size += length + 1;
+
+  uint32_t bucket = hash_device_id(device_id) & devices.table_mask;
+  while (devices.table[bucket]) {
+    bucket = (bucket + 1) & devices.table_mask;
+  }
+  devices.table[bucket] = devices.count + 1;
+  return devices.count++;
+}
+
+// Copies a mapped device table to the heap so it can grow.
+int unshare_devices() {
+  int capacity = 1;
+  while (capacity < devices.count) {
+    capacity *= 2;
+  }
+
+  char *arena = (char *)malloc(devices.arena_size + 1);
+  uint32_t *offsets = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+  uint32_t mask;
+  uint32_t *table = graph_build_name_table(devices.arena, devices.offsets, devices.count, &mask);
+  if (!arena || !offsets || !table) {
+    free(arena);
+    free(offsets);
+    free(table);
+    return 0;
+  }
+  memcpy(arena, devices.arena, devices.arena_size);
+  memcpy(offsets, devices.offsets, devices.count * sizeof(uint32_t));
+
+  devices.arena = arena;
+  devices.arena_capacity = devices.arena_size + 1;
+  devices.offsets = offsets;
+  devices.capacity = capacity;
+  devices.table = table;
+  devices.table_mask = mask;
+  devices.mapped = 0;
+  return 1;
+}
+
+void free_device_table(DeviceTable *table) {
+  if (!table->mapped) {
+    free(table->arena);
+    free(table->offsets);
+    free(table->table);
+  }
+  memset(table, 0, sizeof(*table));
+}
+
+// Queues a link between device numbers for the next build_graph.
+int queue_link(uint32_t from, uint32_t to) {
+  if (pending_edges.count == pending_edges.capacity) {
+    size_t capacity = pending_edges.capacity ? pending_edges.capacity * 2 : EDGES_INITIAL;
+    uint32_t *from_grown = (uint32_t *)realloc(pending_edges.from, capacity * sizeof(uint32_t));
+    if (!from_grown) {
+      return 0;
+    }
+    pending_edges.from = from_grown;
+    uint32_t *to_grown = (uint32_t *)realloc(pending_edges.to, capacity * sizeof(uint32_t));
+    if (!to_grown) {
+      return 0;
+    }
+    pending_edges.to = to_grown;
+    pending_edges.capacity = capacity;
+  }
+
+  pending_edges.from[pending_edges.count] = from;
+  pending_edges.to[pending_edges.count] = to;
+  pending_edges.count++;
+  return 1;
+}
+
+// Queues a link for the next build_graph, registering unknown devices.
+int add_connection(const char *from, const char *to) {
+  int from_idx = add_device(from);
+  int to_idx = add_device(to);
+
+  if (from_idx == -1 || to_idx == -1) {
+    return 0;
+  }
+  return queue_link((uint32_t)from_idx, (uint32_t)to_idx);
+}
+
+// Reads one link per line, "FROM TO" separated by spaces, tabs or a comma.
+// A line with a single ID declares a device with no links; blank lines and
+// lines starting with '#' are skipped.
+int load_edge_list(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    printf("Error: Could not open %s\n", path);
+    return 0;
+  }
+
+  char line[MAX_LINE];
+  long line_number = 0;
+  int ok = 1;
+
+  while (ok && fgets(line, sizeof(line), file)) {
+    line_number++;
+    char *from = line + strspn(line, EDGE_SEPARATORS);
+    if (*from == '\0' || *from == '#') {
+      continue;
+    }
+
+    char *end = from + strcspn(from, EDGE_SEPARATORS);
+    char *to = end + strspn(end, EDGE_SEPARATORS);
+    *end = '\0';
+    to[strcspn(to, EDGE_SEPARATORS)] = '\0';
+
+    if (*to == '\0') {
+      ok = add_device(from) != -1;
+    } else {
+      ok = add_connection(from, to);
+    }
+    if (!ok) {
+      printf("Error: Out of memory at line %ld of %s\n", line_number, path);
+    }
+  }
+
+  fclose(file);
+  return ok;
+}
+
+int compare_ids(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Turns the pending links among `device_count` devices into the forward and reverse CSR arrays with two
+// counting passes, then sorts and deduplicates each row. The pending list
+// is released afterwards.
+int build_graph(int device_count) {
+  int n = device_count;
+  size_t m = pending_edges.count;
+
+  if (m > UINT32_MAX) {
+    printf("Error: Too many links (%zu)\n", m);
+    return 0;
+  }
+
+  free_graph();
+  graph.device_count = n;
+  graph.out_offsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+  graph.in_offsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+  graph.out_targets = (uint32_t *)malloc(m * sizeof(uint32_t) + 1);
+  uint32_t *cursor = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  if (!graph.out_offsets || !graph.in_offsets || !graph.out_targets || !cursor) {
+    free(cursor);
+    free_graph();
+    printf("Error: Out of memory building graph\n");
+    return 0;
+  }
+
+  for (size_t e = 0; e < m; e++) {
+    graph.out_offsets[pending_edges.from[e] + 1]++;
+  }
+  for (int i = 0; i < n; i++) {
+    graph.out_offsets[i + 1] += graph.out_offsets[i];
+  }
+  memcpy(cursor, graph.out_offsets, (n + 1) * sizeof(uint32_t));
+  for (size_t e = 0; e < m; e++) {
+    graph.out_targets[cursor[pending_edges.from[e]]++] = pending_edges.to[e];
+  }
+
+  free(pending_edges.from);
+  free(pending_edges.to);
+  memset(&pending_edges, 0, sizeof(pending_edges));
+
+  // Sort each row and squeeze out repeated links in place.
+  uint32_t write = 0;
+  for (int i = 0; i < n; i++) {
+    uint32_t begin = graph.out_offsets[i];
+    uint32_t end = graph.out_offsets[i + 1];
+    qsort(graph.out_targets + begin, end - begin, sizeof(uint32_t), compare_ids);
+    graph.out_offsets[i] = write;
+    for (uint32_t e = begin; e < end; e++) {
+      if (e == begin || graph.out_targets[e] != graph.out_targets[e - 1]) {
+        graph.out_targets[write++] = graph.out_targets[e];
+      }
+    }
+  }
+  graph.out_offsets[n] = write;
+  graph.edge_count = write;
+
+  uint32_t *shrunk = (uint32_t *)realloc(graph.out_targets, write * sizeof(uint32_t) + 1);
+  if (shrunk) {
+    graph.out_targets = shrunk;
+  }
+  graph.in_sources = (uint32_t *)malloc(write * sizeof(uint32_t) + 1);
+  if (!graph.in_sources) {
+    free(cursor);
+    free_graph();
+    printf("Error: Out of memory building graph\n");
+    return 0;
+  }
+
+  // Walking sources in order leaves every reverse row already sorted.
+  for (uint32_t e = 0; e < write; e++) {
+    graph.in_offsets[graph.out_targets[e] + 1]++;
+  }
+  for (int i = 0; i < n; i++) {
+    graph.in_offsets[i + 1] += graph.in_offsets[i];
+  }
+  memcpy(cursor, graph.in_offsets, (n + 1) * sizeof(uint32_t));
+  for (int i = 0; i < n; i++) {
+    for (uint32_t e = graph.out_offsets[i]; e < graph.out_offsets[i + 1]; e++) {
+      graph.in_sources[cursor[graph.out_targets[e]]++] = (uint32_t)i;
+    }
+  }
+
+  free(cursor);
+  return 1;
+}
+
+// O(log degree) by binary search of the sorted row.
+int has_connection(int from, int to) {
+  uint32_t lo = graph.out_offsets[from];
+  uint32_t hi = graph.out_offsets[from + 1];
 
-  if (from_idx != -1 && to_idx != -1) {
-    adj_matrix[from_idx][to_idx] = 1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (graph.out_targets[mid] < (uint32_t)to) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
+  return lo < graph.out_offsets[from + 1] && graph.out_targets[lo] == (uint32_t)to;
+}
+
+size_t graph_memory_bytes() {
+  return 2 * (graph.device_count + 1) * sizeof(uint32_t) +
+         2 * (size_t)graph.edge_count * sizeof(uint32_t);
 }
 
 void display_adjacency_matrix() {
+  if (graph.device_count > DISPLAY_MATRIX_LIMIT) {
+    printf("\nGraph: %d devices, %u links, %.1f MB in CSR form\n", graph.device_count,
+           graph.edge_count, graph_memory_bytes() / (1024.0 * 1024.0));
+    return;
+  }
+
   printf("\nAdjacency Matrix:\n     ");
-  for (int i = 0; i < device_count; i++) {
-    printf("%5s", devices[i]);
+  for (int i = 0; i < graph.device_count; i++) {
+    printf("%5s", device_name(i));
   }
   printf("\n");
 
-  for (int i = 0; i < device_count; i++) {
-    printf("%5s", devices[i]);
-    for (int j = 0; j < device_count; j++) {
-      printf("%5d", adj_matrix[i][j]);
+  for (int i = 0; i < graph.device_count; i++) {
+    printf("%5s", device_name(i));
+    for (int j = 0; j < graph.device_count; j++) {
+      printf("%5d", has_connection(i, j));
     }
     printf("\n");
   }
@@ -46,66 +662,2428 @@ void display_adjacency_matrix() {
 void query_device_connections(const char *device_id) {
   int device_idx = find_device_index(device_id);
 
-  if (device_idx == -1) {
+  if (device_idx == -1 || (dynamic.active && !dynamic.alive[device_idx])) {
     printf("Device '%s' not found\n", device_id);
     fflush(stdout);
     return;
   }
 
-  printf("\nDevice %s:\n", device_id);
+  printf("\nDevice %s (fan-out %d, fan-in %d):\n", device_id, out_degree(device_idx),
+         in_degree(device_idx));
 
-  printf("Outgoing: ");
-  int has_outgoing = 0;
-  for (int i = 0; i < device_count; i++) {
-    if (adj_matrix[device_idx][i] == 1) {
-      printf("%s ", devices[i]);
-      has_outgoing = 1;
+  if (dynamic.active) {
+    const LinkList *lists[2] = {&dynamic.out[device_idx], &dynamic.in[device_idx]};
+    for (int side = 0; side < 2; side++) {
+      printf("%s", side ? "Incoming: " : "Outgoing: ");
+      for (uint32_t e = 0; e < lists[side]->count; e++) {
+        printf("%s ", device_name(lists[side]->entries[e].device));
+      }
+      if (lists[side]->count == 0)
+        printf("None");
+      printf("\n");
     }
+    printf("Component: %d devices\n",
+           dynamic.component_size[dynamic.component[device_idx]]);
+    fflush(stdout);
+    return;
+  }
+
+  printf("Outgoing: ");
+  uint32_t begin = graph.out_offsets[device_idx];
+  uint32_t end = graph.out_offsets[device_idx + 1];
+  for (uint32_t e = begin; e < end; e++) {
+    printf("%s ", device_name(graph.out_targets[e]));
   }
-  if (!has_outgoing)
+  if (begin == end)
     printf("None");
   printf("\n");
 
   printf("Incoming: ");
-  int has_incoming = 0;
-  for (int i = 0; i < device_count; i++) {
-    if (adj_matrix[i][device_idx] == 1) {
-      printf("%s ", devices[i]);
-      has_incoming = 1;
-    }
+  begin = graph.in_offsets[device_idx];
+  end = graph.in_offsets[device_idx + 1];
+  for (uint32_t e = begin; e < end; e++) {
+    printf("%s ", device_name(graph.in_sources[e]));
   }
-  if (!has_incoming)
+  if (begin == end)
     printf("None");
   printf("\n");
   fflush(stdout);
 }
 
-int main() {
-  printf("IoT Device Communication Tool\n");
+void free_graph() {
+  if (!graph.mapped) {
+    free(graph.out_offsets);
+    free(graph.out_targets);
+    free(graph.in_offsets);
+    free(graph.in_sources);
+  }
+  memset(&graph, 0, sizeof(graph));
+}
 
-  add_connection("D001", "D002");
-  add_connection("D001", "D003");
-  add_connection("D002", "D004");
-  add_connection("D003", "D005");
-  add_connection("D004", "D005");
-  add_connection("D004", "D006");
-  add_connection("D005", "D007");
-  add_connection("D006", "D008");
+// Maps a graph snapshot and uses its names and CSR arrays in place. A
+// route snapshot works too: its rows already list both directions of
+// every road, and the travel times are ignored.
+int open_graph_snapshot(const char *path) {
+  if (!graph_snapshot_open(path, &snapshot, stdout)) {
+    return 0;
+  }
 
-  display_adjacency_matrix();
+  free_graph();
+  graph.device_count = (int)snapshot.node_count;
+  graph.edge_count = snapshot.edge_count;
+  graph.out_offsets = (uint32_t *)snapshot.out_offsets;
+  graph.out_targets = (uint32_t *)snapshot.out_targets;
+  graph.in_offsets = (uint32_t *)snapshot.in_offsets;
+  graph.in_sources = (uint32_t *)snapshot.in_sources;
+  graph.mapped = 1;
 
-  char device_id[10];
-  while (1) {
-    printf("\nEnter device ID (or 'exit'): ");
+  free_device_table(&devices);
+  devices.arena = (char *)snapshot.names;
+  devices.arena_size = snapshot.names_size;
+  devices.arena_capacity = snapshot.names_size;
+  devices.offsets = (uint32_t *)snapshot.name_offsets;
+  devices.count = (int)snapshot.node_count;
+  devices.capacity = (int)snapshot.node_count;
+  devices.table = (uint32_t *)snapshot.name_table;
+  devices.table_mask = snapshot.name_table_mask;
+  devices.mapped = 1;
+  return 1;
+}
+
+// Converts an edge list to a snapshot; the device table and CSR arrays
+// are written as they are.
+int compile_graph_snapshot(const char *edge_path, const char *out_path) {
+  struct timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  if (!load_edge_list(edge_path) || !build_graph(devices.count)) {
+    return 0;
+  }
+
+  GraphSnapshot image = {0};
+  image.node_count = (uint32_t)graph.device_count;
+  image.edge_count = graph.edge_count;
+  image.names = devices.arena;
+  image.names_size = devices.arena_size;
+  image.name_offsets = devices.offsets;
+  image.name_table = devices.table;
+  image.name_table_mask = devices.table_mask;
+  image.out_offsets = graph.out_offsets;
+  image.out_targets = graph.out_targets;
+  image.in_offsets = graph.in_offsets;
+  image.in_sources = graph.in_sources;
+  int ok = graph_snapshot_write(&image, out_path);
+
+  if (ok) {
+    struct stat info;
+    double megabytes = stat(out_path, &info) == 0 ? info.st_size / (1024.0 * 1024.0) : 0;
+    printf("Compiled %d devices and %u links into %s (%.1f MB) in %.1f ms\n",
+           graph.device_count, graph.edge_count, out_path, megabytes, elapsed_ms(&begin));
+  } else {
+    printf("Error: Could not write %s\n", out_path);
+  }
+  free_graph();
+  free_device_table(&devices);
+  return ok;
+}
+
+int build_bitset_graph() {
+  int n = graph.device_count;
+
+  if (n > BITSET_MAX_DEVICES) {
+    printf("Error: Bitset mode supports up to %d devices (graph has %d)\n",
+           BITSET_MAX_DEVICES, n);
+    return 0;
+  }
+
+  free_bitset_graph();
+  bitset.device_count = n;
+  bitset.words = (n + 63) / 64;
+  size_t row_words = (size_t)n * bitset.words;
+  bitset.out_rows = (uint64_t *)calloc(row_words + 1, sizeof(uint64_t));
+  bitset.in_rows = (uint64_t *)calloc(row_words + 1, sizeof(uint64_t));
+  if (!bitset.out_rows || !bitset.in_rows) {
+    free_bitset_graph();
+    printf("Error: Out of memory building bitset graph\n");
+    return 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    for (uint32_t e = graph.out_offsets[i]; e < graph.out_offsets[i + 1]; e++) {
+      uint32_t j = graph.out_targets[e];
+      bitset.out_rows[(size_t)i * bitset.words + j / 64] |= 1ULL << (j % 64);
+      bitset.in_rows[(size_t)j * bitset.words + i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  return 1;
+}
+
+void free_bitset_graph() {
+  free(bitset.out_rows);
+  free(bitset.in_rows);
+  memset(&bitset, 0, sizeof(bitset));
+}
+
+int out_degree(int device) {
+  if (dynamic.active) {
+    return (int)dynamic.out[device].count;
+  }
+  if (!use_bitset) {
+    return graph.out_offsets[device + 1] - graph.out_offsets[device];
+  }
+  const uint64_t *row = bitset.out_rows + (size_t)device * bitset.words;
+  int count = 0;
+  for (int w = 0; w < bitset.words; w++) {
+    count += __builtin_popcountll(row[w]);
+  }
+  return count;
+}
+
+int in_degree(int device) {
+  if (dynamic.active) {
+    return (int)dynamic.in[device].count;
+  }
+  if (!use_bitset) {
+    return graph.in_offsets[device + 1] - graph.in_offsets[device];
+  }
+  const uint64_t *row = bitset.in_rows + (size_t)device * bitset.words;
+  int count = 0;
+  for (int w = 0; w < bitset.words; w++) {
+    count += __builtin_popcountll(row[w]);
+  }
+  return count;
+}
+
+// Devices that both `a` and `b` link to, as a set of (device_count + 63) / 64
+// words; returns how many there are.
+int common_targets(int a, int b, uint64_t *result) {
+  int words = (graph.device_count + 63) / 64;
+  int count = 0;
+
+  if (use_bitset) {
+    const uint64_t *row_a = bitset.out_rows + (size_t)a * words;
+    const uint64_t *row_b = bitset.out_rows + (size_t)b * words;
+    for (int w = 0; w < words; w++) {
+      result[w] = row_a[w] & row_b[w];
+      count += __builtin_popcountll(result[w]);
+    }
+    return count;
+  }
+
+  // Both rows are sorted, so a merge finds the intersection.
+  memset(result, 0, words * sizeof(uint64_t));
+  uint32_t i = graph.out_offsets[a], i_end = graph.out_offsets[a + 1];
+  uint32_t j = graph.out_offsets[b], j_end = graph.out_offsets[b + 1];
+  while (i < i_end && j < j_end) {
+    uint32_t x = graph.out_targets[i], y = graph.out_targets[j];
+    if (x == y) {
+      result[x / 64] |= 1ULL << (x % 64);
+      count++;
+    }
+    i += x <= y;
+    j += y <= x;
+  }
+  return count;
+}
+
+// Marks in `visited` every device reachable from `source` in 1..hops links
+// and returns how many there are (the source counts only if it lies on a
+// cycle). In bitset mode each BFS level ORs the rows of the whole frontier
+// into the next one and masks off what was already seen.
+int reachable_within(int source, int hops, uint64_t *visited) {
+  int n = graph.device_count;
+  int words = (n + 63) / 64;
+  int count = 0;
+
+  memset(visited, 0, words * sizeof(uint64_t));
+  if (use_bitset) {
+    uint64_t *frontier = (uint64_t *)calloc(2 * (size_t)words, sizeof(uint64_t));
+    if (!frontier) {
+      return -1;
+    }
+    uint64_t *next = frontier + words;
+    frontier[source / 64] = 1ULL << (source % 64);
+
+    for (int hop = 0; hop < hops; hop++) {
+      memset(next, 0, words * sizeof(uint64_t));
+      for (int w = 0; w < words; w++) {
+        for (uint64_t bits = frontier[w]; bits; bits &= bits - 1) {
+          const uint64_t *row =
+              bitset.out_rows + (size_t)(w * 64 + __builtin_ctzll(bits)) * words;
+          for (int k = 0; k < words; k++) {
+            next[k] |= row[k];
+          }
+        }
+      }
+      uint64_t any = 0;
+      for (int w = 0; w < words; w++) {
+        next[w] &= ~visited[w];
+        visited[w] |= next[w];
+        any |= next[w];
+      }
+      uint64_t *swap = frontier;
+      frontier = next;
+      next = swap;
+      if (!any) {
+        break;
+      }
+    }
+    free(frontier < next ? frontier : next);
+  } else {
+    uint32_t *queue = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+    if (!queue) {
+      return -1;
+    }
+    int head = 0, tail = 0;
+    queue[tail++] = (uint32_t)source;
+    for (int hop = 0; hop < hops && head < tail; hop++) {
+      int level_end = tail;
+      for (; head < level_end; head++) {
+        uint32_t u = queue[head];
+        for (uint32_t e = graph.out_offsets[u]; e < graph.out_offsets[u + 1]; e++) {
+          uint32_t v = graph.out_targets[e];
+          if (!(visited[v / 64] & (1ULL << (v % 64)))) {
+            visited[v / 64] |= 1ULL << (v % 64);
+            queue[tail++] = v;
+          }
+        }
+      }
+    }
+    free(queue);
+  }
+
+  for (int w = 0; w < words; w++) {
+    count += __builtin_popcountll(visited[w]);
+  }
+  return count;
+}
+
+void print_device_set(const uint64_t *set, int limit) {
+  int words = (graph.device_count + 63) / 64;
+  int printed = 0;
+
+  for (int w = 0; w < words; w++) {
+    for (uint64_t bits = set[w]; bits; bits &= bits - 1) {
+      if (printed == limit) {
+        printf("...");
+        return;
+      }
+      printf("%s ", device_name(w * 64 + __builtin_ctzll(bits)));
+      printed++;
+    }
+  }
+  if (printed == 0)
+    printf("None");
+}
+
+void query_common_targets(const char *first, const char *second) {
+  int a = find_device_index(first);
+  int b = find_device_index(second);
+
+  if (a == -1 || b == -1) {
+    printf("Device '%s' not found\n", a == -1 ? first : second);
     fflush(stdout);
-    scanf("%s", device_id);
+    return;
+  }
 
-    if (strcmp(device_id, "exit") == 0) {
-      break;
+  uint64_t *result = (uint64_t *)malloc(((graph.device_count + 63) / 64 + 1) * sizeof(uint64_t));
+  if (!result) {
+    printf("Error: Out of memory\n");
+    return;
+  }
+  int count = common_targets(a, b, result);
+  printf("\nDevices both %s and %s link to (%d): ", first, second, count);
+  print_device_set(result, REACH_PRINT_LIMIT);
+  printf("\n");
+  fflush(stdout);
+  free(result);
+}
+
+void query_reach(const char *device_id, int hops) {
+  int source = find_device_index(device_id);
+
+  if (source == -1) {
+    printf("Device '%s' not found\n", device_id);
+    fflush(stdout);
+    return;
+  }
+
+  uint64_t *visited = (uint64_t *)malloc(((graph.device_count + 63) / 64 + 1) * sizeof(uint64_t));
+  if (!visited) {
+    printf("Error: Out of memory\n");
+    return;
+  }
+  struct timespec begin, end;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  int count = reachable_within(source, hops, visited);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (count < 0) {
+    printf("Error: Out of memory\n");
+  } else {
+    printf("\n%s reaches %d devices within %d hops (%.1f us, %s): ", device_id, count, hops,
+           (end.tv_sec - begin.tv_sec) * 1e6 + (end.tv_nsec - begin.tv_nsec) / 1e3,
+           use_bitset ? "bitset" : "CSR");
+    print_device_set(visited, REACH_PRINT_LIMIT);
+    printf("\n");
+  }
+  fflush(stdout);
+  free(visited);
+}
+
+// Reallocates an array from `old` to `grown` elements, zeroing the new ones.
+int grow_zeroed(void **array, size_t old, size_t grown, size_t element_size) {
+  char *resized = (char *)realloc(*array, grown * element_size);
+  if (!resized) {
+    return 0;
+  }
+  memset(resized + old * element_size, 0, (grown - old) * element_size);
+  *array = resized;
+  return 1;
+}
+
+// Grows every per-device array of the dynamic graph to hold `count` slots.
+int dynamic_reserve(int count) {
+  DynamicGraph *g = &dynamic;
+  if (count <= g->capacity) {
+    return 1;
+  }
+
+  int capacity = g->capacity ? g->capacity : DEVICES_INITIAL;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+  size_t old = (size_t)g->capacity;
+  size_t grown = (size_t)capacity;
+
+  if (!grow_zeroed((void **)&g->out, old, grown, sizeof(LinkList)) ||
+      !grow_zeroed((void **)&g->in, old, grown, sizeof(LinkList)) ||
+      !grow_zeroed((void **)&g->alive, old, grown, sizeof(unsigned char)) ||
+      !grow_zeroed((void **)&g->component, old, grown, sizeof(int)) ||
+      !grow_zeroed((void **)&g->next_member, old, grown, sizeof(int)) ||
+      !grow_zeroed((void **)&g->prev_member, old, grown, sizeof(int)) ||
+      !grow_zeroed((void **)&g->component_size, old, grown, sizeof(int)) ||
+      !grow_zeroed((void **)&g->free_labels, old, grown, sizeof(int)) ||
+      !grow_zeroed((void **)&g->seen, old, grown, sizeof(uint32_t)) ||
+      !grow_zeroed((void **)&g->queue, 2 * old, 2 * grown, sizeof(int))) {
+    return 0;
+  }
+
+  g->capacity = capacity;
+  return 1;
+}
+
+// Makes device v a component of its own and returns the label.
+int new_component(int v) {
+  DynamicGraph *g = &dynamic;
+  int label = g->free_label_count ? g->free_labels[--g->free_label_count] : g->next_label++;
+
+  g->component[v] = label;
+  g->component_size[label] = 1;
+  g->next_member[v] = v;
+  g->prev_member[v] = v;
+  g->component_count++;
+  return label;
+}
+
+// Relabels the smaller of the two components and splices its member ring
+// into the larger one; O(size of the smaller component).
+void merge_components(int a, int b) {
+  DynamicGraph *g = &dynamic;
+  int keep = g->component[a];
+  int drop = g->component[b];
+
+  if (keep == drop) {
+    return;
+  }
+  if (g->component_size[keep] < g->component_size[drop]) {
+    int swap = a;
+    a = b;
+    b = swap;
+    keep = g->component[a];
+    drop = g->component[b];
+  }
+
+  int v = b;
+  do {
+    g->component[v] = keep;
+    v = g->next_member[v];
+  } while (v != b);
+
+  int a_next = g->next_member[a];
+  int b_prev = g->prev_member[b];
+  g->next_member[a] = b;
+  g->prev_member[b] = a;
+  g->next_member[b_prev] = a_next;
+  g->prev_member[a_next] = b_prev;
+
+  g->component_size[keep] += g->component_size[drop];
+  g->free_labels[g->free_label_count++] = drop;
+  g->component_count--;
+}
+
+int link_list_push(LinkList *list, uint32_t device, uint32_t twin) {
+  if (list->count == list->capacity) {
+    uint32_t capacity = list->capacity ? list->capacity * 2 : LINK_LIST_INITIAL;
+    LinkEntry *grown = (LinkEntry *)realloc(list->entries, capacity * sizeof(LinkEntry));
+    if (!grown) {
+      return 0;
+    }
+    list->entries = grown;
+    list->capacity = capacity;
+  }
+  list->entries[list->count].device = device;
+  list->entries[list->count].twin = twin;
+  list->count++;
+  return 1;
+}
+
+// Copies the CSR graph into per-device lists and labels its weakly
+// connected components with one BFS; O(devices + links). Updates then
+// work on these lists until sync_graph turns them back into CSR.
+int start_dynamic() {
+  DynamicGraph *g = &dynamic;
+  int n = graph.device_count;
+
+  if (g->active) {
+    return 1;
+  }
+  memset(g, 0, sizeof(*g));
+  if (!dynamic_reserve(n > 0 ? n : 1)) {
+    free_dynamic();
+    return 0;
+  }
+  g->device_count = n;
+  g->alive_count = n;
+  g->edge_count = graph.edge_count;
+
+  for (int i = 0; i < n; i++) {
+    uint32_t out_count = graph.out_offsets[i + 1] - graph.out_offsets[i];
+    uint32_t in_count = graph.in_offsets[i + 1] - graph.in_offsets[i];
+    if (out_count) {
+      g->out[i].entries = (LinkEntry *)malloc(out_count * sizeof(LinkEntry));
+      g->out[i].capacity = out_count;
+    }
+    if (in_count) {
+      g->in[i].entries = (LinkEntry *)malloc(in_count * sizeof(LinkEntry));
+      g->in[i].capacity = in_count;
+    }
+    if ((out_count && !g->out[i].entries) || (in_count && !g->in[i].entries)) {
+      free_dynamic();
+      return 0;
+    }
+    g->alive[i] = 1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    for (uint32_t e = graph.out_offsets[i]; e < graph.out_offsets[i + 1]; e++) {
+      uint32_t j = graph.out_targets[e];
+      LinkList *out = &g->out[i];
+      LinkList *in = &g->in[j];
+      out->entries[out->count].device = j;
+      out->entries[out->count].twin = in->count;
+      in->entries[in->count].device = (uint32_t)i;
+      in->entries[in->count].twin = out->count;
+      out->count++;
+      in->count++;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    g->component[i] = -1;
+  }
+  for (int root = 0; root < n; root++) {
+    if (g->component[root] != -1) {
+      continue;
+    }
+    int label = new_component(root);
+    int head = 0, tail = 0;
+    g->queue[tail++] = root;
+    while (head < tail) {
+      int v = g->queue[head++];
+      const LinkList *lists[2] = {&g->out[v], &g->in[v]};
+      for (int side = 0; side < 2; side++) {
+        for (uint32_t e = 0; e < lists[side]->count; e++) {
+          int w = (int)lists[side]->entries[e].device;
+          if (g->component[w] == -1) {
+            g->component[w] = label;
+            g->queue[tail++] = w;
+          }
+        }
+      }
+    }
+    // Thread the member ring in BFS order.
+    for (int k = 0; k < tail; k++) {
+      int v = g->queue[k];
+      g->next_member[v] = g->queue[(k + 1) % tail];
+      g->prev_member[v] = g->queue[(k + tail - 1) % tail];
+    }
+    g->component_size[label] = tail;
+  }
+
+  g->active = 1;
+  return 1;
+}
+
+void free_dynamic() {
+  DynamicGraph *g = &dynamic;
+  for (int i = 0; i < g->capacity; i++) {
+    free(g->out[i].entries);
+    free(g->in[i].entries);
+  }
+  free(g->out);
+  free(g->in);
+  free(g->alive);
+  free(g->component);
+  free(g->next_member);
+  free(g->prev_member);
+  free(g->component_size);
+  free(g->free_labels);
+  free(g->seen);
+  free(g->queue);
+  memset(g, 0, sizeof(*g));
+}
+
+// Position of the link from -> to in from's out-list, or -1. Scans the
+// shorter of from's out-list and to's in-list.
+long find_link(int from, int to) {
+  const LinkList *out = &dynamic.out[from];
+  const LinkList *in = &dynamic.in[to];
+
+  if (out->count <= in->count) {
+    for (uint32_t e = 0; e < out->count; e++) {
+      if (out->entries[e].device == (uint32_t)to) {
+        return e;
+      }
     }
+  } else {
+    for (uint32_t e = 0; e < in->count; e++) {
+      if (in->entries[e].device == (uint32_t)from) {
+        return in->entries[e].twin;
+      }
+    }
+  }
+  return -1;
+}
+
+// Drops both halves of a link by moving the last entry of each list into
+// the hole and repointing that entry's twin.
+void remove_link_at(int from, uint32_t position) {
+  LinkList *out = &dynamic.out[from];
+  uint32_t to = out->entries[position].device;
+  uint32_t twin = out->entries[position].twin;
+
+  LinkEntry moved = out->entries[--out->count];
+  if (position != out->count) {
+    out->entries[position] = moved;
+    dynamic.in[moved.device].entries[moved.twin].twin = position;
+  }
 
-    query_device_connections(device_id);
+  LinkList *in = &dynamic.in[to];
+  moved = in->entries[--in->count];
+  if (twin != in->count) {
+    in->entries[twin] = moved;
+    dynamic.out[moved.device].entries[moved.twin].twin = twin;
   }
+  dynamic.edge_count--;
+}
+
+// Called once no link joins u and v in either direction. Searches outward
+// from both devices in turn, one device per step: if the searches meet the
+// component is intact; if one runs dry first, everything it found becomes
+// a component of its own. The work is proportional to the smaller side.
+void split_if_disconnected(int u, int v) {
+  DynamicGraph *g = &dynamic;
+  int *queues[2] = {g->queue, g->queue + g->capacity};
+  int head[2] = {0, 0};
+  int tail[2] = {1, 1};
+
+  g->epoch += 2;
+  if (g->epoch < 2) {
+    memset(g->seen, 0, g->capacity * sizeof(uint32_t));
+    g->epoch = 2;
+  }
+  queues[0][0] = u;
+  queues[1][0] = v;
+  g->seen[u] = g->epoch;
+  g->seen[v] = g->epoch + 1;
+
+  while (1) {
+    for (int side = 0; side < 2; side++) {
+      if (head[side] == tail[side]) {
+        // This side is cut off: unthread its devices from the old ring and
+        // give them a ring and label of their own.
+        int *found = queues[side];
+        int count = tail[side];
+        int old = g->component[found[0]];
+        for (int k = 0; k < count; k++) {
+          int x = found[k];
+          g->next_member[g->prev_member[x]] = g->next_member[x];
+          g->prev_member[g->next_member[x]] = g->prev_member[x];
+        }
+        g->component_size[old] -= count;
+        int label = new_component(found[0]);
+        for (int k = 1; k < count; k++) {
+          int x = found[k];
+          g->component[x] = label;
+          g->prev_member[x] = found[k - 1];
+          g->next_member[found[k - 1]] = x;
+        }
+        g->next_member[found[count - 1]] = found[0];
+        g->prev_member[found[0]] = found[count - 1];
+        g->component_size[label] = count;
+        return;
+      }
+
+      int x = queues[side][head[side]++];
+      const LinkList *lists[2] = {&g->out[x], &g->in[x]};
+      for (int dir = 0; dir < 2; dir++) {
+        for (uint32_t e = 0; e < lists[dir]->count; e++) {
+          int y = (int)lists[dir]->entries[e].device;
+          if (g->seen[y] == g->epoch + 1 - side) {
+            return;
+          }
+          if (g->seen[y] != g->epoch + side) {
+            g->seen[y] = g->epoch + side;
+            queues[side][tail[side]++] = y;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Returns the device's number, registering it or bringing it back if it
+// was removed; `joined` reports whether it was new. -1 if out of memory.
+int join_device(const char *device_id, int *joined) {
+  DynamicGraph *g = &dynamic;
+  int index = find_device_index(device_id);
+
+  *joined = 0;
+  if (index != -1 && index < g->device_count && g->alive[index]) {
+    return index;
+  }
+  if (index == -1) {
+    index = add_device(device_id);
+    if (index == -1) {
+      return -1;
+    }
+  }
+  if (!dynamic_reserve(index + 1)) {
+    return -1;
+  }
+  if (index >= g->device_count) {
+    g->device_count = index + 1;
+  }
+  g->alive[index] = 1;
+  g->alive_count++;
+  new_component(index);
+  *joined = 1;
+  return index;
+}
+
+// Adds from -> to, registering unknown devices. 1 if added, 0 if it was
+// already there, -1 if out of memory. O(min(fan-out of from, fan-in of to)).
+int insert_link(const char *from, const char *to) {
+  int joined;
+  int u = join_device(from, &joined);
+  int v = u == -1 ? -1 : join_device(to, &joined);
+
+  if (u == -1 || v == -1) {
+    return -1;
+  }
+  if (find_link(u, v) != -1) {
+    return 0;
+  }
+
+  LinkList *out = &dynamic.out[u];
+  LinkList *in = &dynamic.in[v];
+  if (!link_list_push(out, (uint32_t)v, in->count)) {
+    return -1;
+  }
+  if (!link_list_push(in, (uint32_t)u, out->count - 1)) {
+    out->count--;
+    return -1;
+  }
+  dynamic.edge_count++;
+  merge_components(u, v);
+  return 1;
+}
+
+// Removes from -> to. 1 if removed, 0 if there was no such link.
+int delete_link(const char *from, const char *to) {
+  int u = find_device_index(from);
+  int v = find_device_index(to);
+
+  if (u == -1 || v == -1 || u >= dynamic.device_count || v >= dynamic.device_count) {
+    return 0;
+  }
+  long position = find_link(u, v);
+  if (position == -1) {
+    return 0;
+  }
+  remove_link_at(u, (uint32_t)position);
+  if (u != v && find_link(v, u) == -1) {
+    split_if_disconnected(u, v);
+  }
+  return 1;
+}
+
+// Unlinks the device from everything and retires it. 1 if it was present.
+int leave_device(const char *device_id) {
+  DynamicGraph *g = &dynamic;
+  int x = find_device_index(device_id);
+
+  if (x == -1 || x >= g->device_count || !g->alive[x]) {
+    return 0;
+  }
+  while (g->out[x].count > 0) {
+    uint32_t last = g->out[x].count - 1;
+    int y = (int)g->out[x].entries[last].device;
+    remove_link_at(x, last);
+    if (y != x && find_link(y, x) == -1) {
+      split_if_disconnected(x, y);
+    }
+  }
+  while (g->in[x].count > 0) {
+    LinkEntry last = g->in[x].entries[g->in[x].count - 1];
+    remove_link_at((int)last.device, last.twin);
+    split_if_disconnected(x, (int)last.device);
+  }
+
+  // Now a component of one.
+  int label = g->component[x];
+  g->free_labels[g->free_label_count++] = label;
+  g->component_count--;
+  g->component[x] = -1;
+  g->alive[x] = 0;
+  g->alive_count--;
+  return 1;
+}
+
+// Applies one update: '+' with two IDs adds a link, with one a device;
+// '-' removes them. Returns 1 if the graph changed, 0 if not, -1 if out of
+// memory.
+int apply_update(char op, const char *first, const char *second, UpdateCounts *counts) {
+  int result;
+  long *changed;
+
+  if (!dynamic.active && !start_dynamic()) {
+    return -1;
+  }
+  if (op == '+' && second) {
+    result = insert_link(first, second);
+    changed = &counts->links_added;
+  } else if (op == '-' && second) {
+    result = delete_link(first, second);
+    changed = &counts->links_removed;
+  } else if (op == '+') {
+    int joined;
+    result = join_device(first, &joined) == -1 ? -1 : joined;
+    changed = &counts->devices_joined;
+  } else {
+    result = leave_device(first);
+    changed = &counts->devices_left;
+  }
+
+  if (result == 1) {
+    (*changed)++;
+  } else if (result == 0) {
+    counts->unchanged++;
+  }
+  return result;
+}
+
+// Interactive form of apply_update.
+void update_command(char op, const char *first, const char *second) {
+  UpdateCounts counts = {0};
+  int result = apply_update(op, first, second, &counts);
+
+  if (result == -1) {
+    printf("Error: Out of memory\n");
+  } else if (second) {
+    printf("%s %s -> %s\n",
+           result ? (op == '+' ? "Linked" : "Unlinked")
+                  : (op == '+' ? "Already linked:" : "No link"),
+           first, second);
+  } else {
+    printf("%s %s\n",
+           result ? (op == '+' ? "Joined" : "Removed")
+                  : (op == '+' ? "Already present:" : "No device"),
+           first);
+  }
+  fflush(stdout);
+}
+
+// Reads updates one per line from `path` ("-" for stdin), "+ FROM TO",
+// "- FROM TO", "+ ID" or "- ID" with the same separators and comments as
+// an edge list, and reports how fast they were applied.
+int apply_update_stream(const char *path) {
+  FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!file) {
+    printf("Error: Could not open %s\n", path);
+    return 0;
+  }
+  if (!start_dynamic()) {
+    printf("Error: Out of memory\n");
+    if (file != stdin) {
+      fclose(file);
+    }
+    return 0;
+  }
+
+  UpdateCounts counts = {0};
+  char line[MAX_LINE];
+  long line_number = 0, applied = 0;
+  int ok = 1;
+  struct timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  while (ok && fgets(line, sizeof(line), file)) {
+    line_number++;
+    char *op = line + strspn(line, EDGE_SEPARATORS);
+    if (*op == '\0' || *op == '#') {
+      continue;
+    }
+    char *first = op + 1;
+    first += strspn(first, EDGE_SEPARATORS);
+    char *end = first + strcspn(first, EDGE_SEPARATORS);
+    char *second = end + strspn(end, EDGE_SEPARATORS);
+    *end = '\0';
+    second[strcspn(second, EDGE_SEPARATORS)] = '\0';
+
+    if ((*op != '+' && *op != '-') || *first == '\0' ||
+        strlen(first) >= MAX_DEVICE_ID || strlen(second) >= MAX_DEVICE_ID) {
+      counts.malformed++;
+      continue;
+    }
+    if (apply_update(*op, first, *second ? second : NULL, &counts) == -1) {
+      printf("Error: Out of memory at line %ld of %s\n", line_number, path);
+      ok = 0;
+    }
+    applied++;
+  }
+  double ms = elapsed_ms(&begin);
+  if (file != stdin) {
+    fclose(file);
+  }
+
+  printf("Applied %ld updates in %.1f ms (%.0f updates/s, %.0f ns each)\n", applied, ms,
+         ms > 0 ? applied / (ms / 1e3) : 0.0, applied ? ms * 1e6 / applied : 0.0);
+  printf("  %ld links added, %ld removed, %ld devices joined, %ld left, %ld no-ops, "
+         "%ld malformed lines\n",
+         counts.links_added, counts.links_removed, counts.devices_joined, counts.devices_left,
+         counts.unchanged, counts.malformed);
+  print_dynamic_stats();
+  return ok;
+}
+
+void print_dynamic_stats() {
+  if (!dynamic.active && !start_dynamic()) {
+    printf("Error: Out of memory\n");
+    return;
+  }
+  printf("Graph: %d devices, %llu links, %d connected components\n", dynamic.alive_count,
+         (unsigned long long)dynamic.edge_count, dynamic.component_count);
+  fflush(stdout);
+}
+
+// Brings the CSR graph (and bitset rows) up to date after updates,
+// renumbering devices so removed ones leave no gaps; O(devices + links).
+// The dynamic lists are released and rebuilt from CSR on the next update.
+int sync_graph() {
+  DynamicGraph *g = &dynamic;
+  if (!g->active) {
+    return 1;
+  }
+  if (g->edge_count > UINT32_MAX) {
+    printf("Error: Too many links (%llu)\n", (unsigned long long)g->edge_count);
+    return 0;
+  }
+
+  uint32_t *renumber = (uint32_t *)malloc((g->device_count + 1) * sizeof(uint32_t));
+  if (!renumber) {
+    printf("Error: Out of memory\n");
+    return 0;
+  }
+  DeviceTable old = devices;
+  memset(&devices, 0, sizeof(devices));
+  int ok = 1;
+  for (int i = 0; ok && i < g->device_count; i++) {
+    if (g->alive[i]) {
+      int index = add_device(old.arena + old.offsets[i]);
+      renumber[i] = (uint32_t)index;
+      ok = index != -1;
+    }
+  }
+  for (int i = 0; ok && i < g->device_count; i++) {
+    for (uint32_t e = 0; ok && e < g->out[i].count; e++) {
+      ok = queue_link(renumber[i], renumber[g->out[i].entries[e].device]);
+    }
+  }
+  free(renumber);
+  if (!ok) {
+    // Keep the old numbering so the dynamic lists stay valid.
+    free_device_table(&devices);
+    devices = old;
+    free(pending_edges.from);
+    free(pending_edges.to);
+    memset(&pending_edges, 0, sizeof(pending_edges));
+    printf("Error: Out of memory\n");
+    return 0;
+  }
+  free_device_table(&old);
+  free_dynamic();
+
+  if (!build_graph(devices.count)) {
+    return 0;
+  }
+  if (use_bitset && !build_bitset_graph()) {
+    printf("Falling back to CSR queries\n");
+    use_bitset = 0;
+  }
+  return 1;
+}
+
+// Submits to the calling worker's own deque, or round-robin from outside
+// the pool. Tasks may submit further tasks; pool_wait returns once every
+// task, including those, has finished.
+void pool_submit(TaskFn fn, void *arg) {
+  Task task = {fn, arg};
+  int target = pool_worker;
+
+  if (target < 0) {
+    target = (int)(__atomic_fetch_add(&pool.next_deque, 1, __ATOMIC_RELAXED) % pool.workers);
+  }
+  __atomic_add_fetch(&pool.pending, 1, __ATOMIC_SEQ_CST);
+  if (!deque_push(&pool.deques[target], task)) {
+    // Out of memory growing the deque: run it here instead.
+    fn(arg);
+    if (__atomic_sub_fetch(&pool.pending, 1, __ATOMIC_SEQ_CST) == 0) {
+      pthread_mutex_lock(&pool.idle_lock);
+      pthread_cond_broadcast(&pool.all_done);
+      pthread_mutex_unlock(&pool.idle_lock);
+    }
+    return;
+  }
+  __atomic_add_fetch(&pool.queued, 1, __ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock(&pool.idle_lock);
+  if (pool.sleepers > 0) {
+    pthread_cond_signal(&pool.work_ready);
+  }
+  pthread_mutex_unlock(&pool.idle_lock);
+}
+
+int deque_push(TaskDeque *deque, Task task) {
+  pthread_mutex_lock(&deque->lock);
+  if (deque->tail == deque->capacity) {
+    if (deque->head > 0) {
+      memmove(deque->tasks, deque->tasks + deque->head,
+              (deque->tail - deque->head) * sizeof(Task));
+      deque->tail -= deque->head;
+      deque->head = 0;
+    } else {
+      int capacity = deque->capacity ? deque->capacity * 2 : POOL_DEQUE_INITIAL;
+      Task *grown = (Task *)realloc(deque->tasks, capacity * sizeof(Task));
+      if (!grown) {
+        pthread_mutex_unlock(&deque->lock);
+        return 0;
+      }
+      deque->tasks = grown;
+      deque->capacity = capacity;
+    }
+  }
+  deque->tasks[deque->tail++] = task;
+  pthread_mutex_unlock(&deque->lock);
+  return 1;
+}
+
+// The owner takes the newest task...
+int deque_pop(TaskDeque *deque, Task *task) {
+  int found = 0;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->tail > deque->head) {
+    *task = deque->tasks[--deque->tail];
+    found = 1;
+  }
+  if (deque->tail == deque->head) {
+    deque->head = deque->tail = 0;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+// ...and thieves the oldest, which in divide-and-conquer work is the
+// largest piece left.
+int deque_steal(TaskDeque *deque, Task *task) {
+  int found = 0;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->tail > deque->head) {
+    *task = deque->tasks[deque->head++];
+    found = 1;
+  }
+  if (deque->tail == deque->head) {
+    deque->head = deque->tail = 0;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+void *pool_thread(void *arg) {
+  int self = (int)(intptr_t)arg;
+  Task task;
+
+  pool_worker = self;
+  while (1) {
+    int found = deque_pop(&pool.deques[self], &task);
+    for (int i = 1; !found && i < pool.workers; i++) {
+      found = deque_steal(&pool.deques[(self + i) % pool.workers], &task);
+    }
+
+    if (found) {
+      __atomic_sub_fetch(&pool.queued, 1, __ATOMIC_SEQ_CST);
+      task.fn(task.arg);
+      if (__atomic_sub_fetch(&pool.pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&pool.idle_lock);
+        pthread_cond_broadcast(&pool.all_done);
+        pthread_mutex_unlock(&pool.idle_lock);
+      }
+      continue;
+    }
+
+    pthread_mutex_lock(&pool.idle_lock);
+    while (!pool.shutdown && __atomic_load_n(&pool.queued, __ATOMIC_SEQ_CST) == 0) {
+      pool.sleepers++;
+      pthread_cond_wait(&pool.work_ready, &pool.idle_lock);
+      pool.sleepers--;
+    }
+    int stop = pool.shutdown && __atomic_load_n(&pool.queued, __ATOMIC_SEQ_CST) == 0;
+    pthread_mutex_unlock(&pool.idle_lock);
+    if (stop) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+int pool_start(int workers) {
+  memset(&pool, 0, sizeof(pool));
+  pool.workers = workers;
+  pool.deques = (TaskDeque *)calloc(workers, sizeof(TaskDeque));
+  pool.threads = (pthread_t *)calloc(workers, sizeof(pthread_t));
+  if (!pool.deques || !pool.threads) {
+    free(pool.deques);
+    free(pool.threads);
+    return 0;
+  }
+  pthread_mutex_init(&pool.idle_lock, NULL);
+  pthread_cond_init(&pool.work_ready, NULL);
+  pthread_cond_init(&pool.all_done, NULL);
+  for (int i = 0; i < workers; i++) {
+    pthread_mutex_init(&pool.deques[i].lock, NULL);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    if (pthread_create(&pool.threads[i], NULL, pool_thread, (void *)(intptr_t)i) != 0) {
+      pool.workers = i;
+      pool_stop();
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void pool_wait() {
+  pthread_mutex_lock(&pool.idle_lock);
+  while (__atomic_load_n(&pool.pending, __ATOMIC_SEQ_CST) > 0) {
+    pthread_cond_wait(&pool.all_done, &pool.idle_lock);
+  }
+  pthread_mutex_unlock(&pool.idle_lock);
+}
+
+void pool_stop() {
+  pthread_mutex_lock(&pool.idle_lock);
+  pool.shutdown = 1;
+  pthread_cond_broadcast(&pool.work_ready);
+  pthread_mutex_unlock(&pool.idle_lock);
+
+  for (int i = 0; i < pool.workers; i++) {
+    pthread_join(pool.threads[i], NULL);
+  }
+  for (int i = 0; i < pool.workers; i++) {
+    free(pool.deques[i].tasks);
+    pthread_mutex_destroy(&pool.deques[i].lock);
+  }
+  pthread_mutex_destroy(&pool.idle_lock);
+  pthread_cond_destroy(&pool.work_ready);
+  pthread_cond_destroy(&pool.all_done);
+  free(pool.deques);
+  free(pool.threads);
+  memset(&pool, 0, sizeof(pool));
+}
+
+void run_range(void *arg) {
+  RangeTask *task = (RangeTask *)arg;
+  task->fn(task->begin, task->end, task->context);
+}
+
+// Splits [0, count) into PARALLEL_CHUNK pieces across the pool and waits
+// for all of them. Called from outside the pool only.
+void parallel_for(int count, RangeFn fn, void *context) {
+  int chunks = (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+  if (chunks <= 1) {
+    fn(0, count, context);
+    return;
+  }
+
+  RangeTask *tasks = (RangeTask *)malloc(chunks * sizeof(RangeTask));
+  if (!tasks) {
+    fn(0, count, context);
+    return;
+  }
+  for (int c = 0; c < chunks; c++) {
+    tasks[c].fn = fn;
+    tasks[c].context = context;
+    tasks[c].begin = c * PARALLEL_CHUNK;
+    tasks[c].end = c == chunks - 1 ? count : (c + 1) * PARALLEL_CHUNK;
+    pool_submit(run_range, &tasks[c]);
+  }
+  pool_wait();
+  free(tasks);
+}
+
+// A device with no remaining in-links or no remaining out-links (self-loops
+// aside) is an SCC on its own, and trimming it may leave its neighbors in
+// the same state. Trimming is a worklist, like Kahn's algorithm run from
+// both ends: per-device counters of untrimmed in- and out-links, and each
+// round trims the devices whose counter the previous round took to zero.
+// Every device and link is handled once, however deep the graph.
+
+// Claims `v` for trimming; returns 0 if another worker got there first.
+int trim_device(int v) {
+  int color = 0;
+  if (!__atomic_compare_exchange_n(&scc.color[v], &color, -1, 0, __ATOMIC_RELAXED,
+                                   __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  scc.component[v] = v;
+  return 1;
+}
+
+void trim_flush(const uint32_t *local, int used) {
+  if (used == 0) {
+    return;
+  }
+  int at = __atomic_fetch_add(&scc.trim_count, used, __ATOMIC_RELAXED);
+  memcpy(scc.trimmed + at, local, used * sizeof(uint32_t));
+}
+
+// Counts each device's links and seeds the worklist with the devices that
+// have no in- or out-links to begin with.
+void trim_seed_range(int begin, int end, void *context) {
+  (void)context;
+  uint32_t local[TRIM_LOCAL_BUFFER];
+  int used = 0;
+
+  for (int v = begin; v < end; v++) {
+    int in = 0, out = 0;
+    for (uint32_t e = graph.out_offsets[v]; e < graph.out_offsets[v + 1]; e++) {
+      out += (int)graph.out_targets[e] != v;
+    }
+    for (uint32_t e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++) {
+      in += (int)graph.in_sources[e] != v;
+    }
+    scc.in_left[v] = in;
+    scc.out_left[v] = out;
+    if ((in == 0 || out == 0) && trim_device(v)) {
+      local[used++] = v;
+      if (used == TRIM_LOCAL_BUFFER) {
+        trim_flush(local, used);
+        used = 0;
+      }
+    }
+  }
+  trim_flush(local, used);
+}
+
+void trim_level_range(int begin, int end, void *context) {
+  (void)context;
+  uint32_t local[TRIM_LOCAL_BUFFER];
+  int used = 0;
+
+  for (int i = scc.trim_begin + begin; i < scc.trim_begin + end; i++) {
+    int v = scc.trimmed[i];
+    for (int forward = 1; forward >= 0; forward--) {
+      const uint32_t *offsets = forward ? graph.out_offsets : graph.in_offsets;
+      const uint32_t *links = forward ? graph.out_targets : graph.in_sources;
+      int *left = forward ? scc.in_left : scc.out_left;
+      for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+        int u = links[e];
+        if (u != v && __atomic_sub_fetch(&left[u], 1, __ATOMIC_RELAXED) == 0 &&
+            trim_device(u)) {
+          local[used++] = u;
+          if (used == TRIM_LOCAL_BUFFER) {
+            trim_flush(local, used);
+            used = 0;
+          }
+        }
+      }
+    }
+  }
+  trim_flush(local, used);
+}
+
+// Marks (with `bit`) every device of `color` reachable from `pivot` along
+// out-links (forward) or in-links (backward). `queue` has room for the
+// whole subproblem.
+int mark_reachable(int pivot, int color, int forward, unsigned char bit, uint32_t *queue) {
+  const uint32_t *offsets = forward ? graph.out_offsets : graph.in_offsets;
+  const uint32_t *links = forward ? graph.out_targets : graph.in_sources;
+  int head = 0, tail = 0;
+
+  scc.mark[pivot] |= bit;
+  queue[tail++] = pivot;
+  while (head < tail) {
+    uint32_t v = queue[head++];
+    for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      uint32_t u = links[e];
+      if (!(scc.mark[u] & bit) && __atomic_load_n(&scc.color[u], __ATOMIC_RELAXED) == color) {
+        scc.mark[u] |= bit;
+        queue[tail++] = u;
+      }
+    }
+  }
+  return tail;
+}
+
+void submit_scc_task(int *vertices, int count) {
+  if (count == 1) {
+    scc.component[vertices[0]] = vertices[0];
+    __atomic_store_n(&scc.color[vertices[0]], -1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&scc.count, 1, __ATOMIC_RELAXED);
+    free(vertices);
+    return;
+  }
+
+  SccTask *task = (SccTask *)malloc(sizeof(SccTask));
+  if (!task) {
+    __atomic_store_n(&scc.failed, 1, __ATOMIC_RELAXED);
+    free(vertices);
+    return;
+  }
+  int color = __atomic_add_fetch(&scc.next_color, 1, __ATOMIC_RELAXED);
+  for (int i = 0; i < count; i++) {
+    __atomic_store_n(&scc.color[vertices[i]], color, __ATOMIC_RELAXED);
+  }
+  task->vertices = vertices;
+  task->count = count;
+  task->color = color;
+  pool_submit(fwbw_task, task);
+}
+
+// Forward-backward step: the devices both reachable from a pivot and able
+// to reach it form the pivot's SCC. Every other SCC of the subproblem lies
+// entirely within the forward-only, backward-only or unreached remainder,
+// so those three become independent subproblems for the pool.
+void fwbw_task(void *arg) {
+  SccTask *task = (SccTask *)arg;
+  int pivot = task->vertices[0];
+  uint32_t *queue = (uint32_t *)malloc(task->count * sizeof(uint32_t));
+  int *parts[3] = {NULL, NULL, NULL};
+  int sizes[3] = {0, 0, 0};
+
+  if (queue) {
+    parts[0] = (int *)malloc(task->count * sizeof(int));
+    parts[1] = (int *)malloc(task->count * sizeof(int));
+    parts[2] = (int *)malloc(task->count * sizeof(int));
+  }
+  if (!queue || !parts[0] || !parts[1] || !parts[2]) {
+    __atomic_store_n(&scc.failed, 1, __ATOMIC_RELAXED);
+    free(queue);
+    free(parts[0]);
+    free(parts[1]);
+    free(parts[2]);
+    free(task->vertices);
+    free(task);
+    return;
+  }
+
+  mark_reachable(pivot, task->color, 1, 1, queue);
+  mark_reachable(pivot, task->color, 0, 2, queue);
+  free(queue);
+
+  for (int i = 0; i < task->count; i++) {
+    int v = task->vertices[i];
+    unsigned char mark = scc.mark[v];
+    scc.mark[v] = 0;
+    if (mark == 3) {
+      scc.component[v] = pivot;
+      __atomic_store_n(&scc.color[v], -1, __ATOMIC_RELAXED);
+    } else {
+      // 1 = forward only, 2 = backward only, 0 = neither
+      int part = mark == 0 ? 2 : mark - 1;
+      parts[part][sizes[part]++] = v;
+    }
+  }
+  __atomic_add_fetch(&scc.count, 1, __ATOMIC_RELAXED);
+  free(task->vertices);
+  free(task);
+
+  for (int p = 0; p < 3; p++) {
+    if (sizes[p] > 0) {
+      submit_scc_task(parts[p], sizes[p]);
+    } else {
+      free(parts[p]);
+    }
+  }
+}
+
+// Labels every device with its strongly connected component (the ID of
+// one member) and returns how many there are, or -1 if out of memory.
+int parallel_scc(int *component) {
+  int n = graph.device_count;
+
+  memset(&scc, 0, sizeof(scc));
+  scc.component = component;
+  scc.color = (int *)calloc(n + 1, sizeof(int));
+  scc.mark = (unsigned char *)calloc(n + 1, 1);
+  scc.in_left = (int *)malloc((n + 1) * sizeof(int));
+  scc.out_left = (int *)malloc((n + 1) * sizeof(int));
+  scc.trimmed = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  if (!scc.color || !scc.mark || !scc.in_left || !scc.out_left || !scc.trimmed) {
+    free(scc.color);
+    free(scc.mark);
+    free(scc.in_left);
+    free(scc.out_left);
+    free(scc.trimmed);
+    return -1;
+  }
+
+  parallel_for(n, trim_seed_range, NULL);
+  while (scc.trim_begin < scc.trim_count) {
+    int round_end = scc.trim_count;
+    parallel_for(round_end - scc.trim_begin, trim_level_range, NULL);
+    scc.trim_begin = round_end;
+  }
+  scc.count = scc.trim_count;
+  free(scc.in_left);
+  free(scc.out_left);
+  free(scc.trimmed);
+
+  int remaining = 0;
+  for (int v = 0; v < n; v++) {
+    remaining += scc.color[v] >= 0;
+  }
+  if (remaining > 0) {
+    int *vertices = (int *)malloc(remaining * sizeof(int));
+    if (!vertices) {
+      scc.failed = 1;
+    } else {
+      remaining = 0;
+      for (int v = 0; v < n; v++) {
+        if (scc.color[v] >= 0) {
+          vertices[remaining++] = v;
+        }
+      }
+      submit_scc_task(vertices, remaining);
+      pool_wait();
+    }
+  }
+
+  free(scc.color);
+  free(scc.mark);
+  return scc.failed ? -1 : scc.count;
+}
+
+// Sequential Tarjan with an explicit stack; the reference --bench checks
+// the parallel result against.
+int tarjan_scc(int *component) {
+  int n = graph.device_count;
+  int *index = (int *)malloc((n + 1) * sizeof(int));
+  int *low = (int *)malloc((n + 1) * sizeof(int));
+  uint32_t *cursor = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  int *call_stack = (int *)malloc((n + 1) * sizeof(int));
+  int *scc_stack = (int *)malloc((n + 1) * sizeof(int));
+  unsigned char *on_stack = (unsigned char *)calloc(n + 1, 1);
+  int count = 0;
+
+  if (!index || !low || !cursor || !call_stack || !scc_stack || !on_stack) {
+    count = -1;
+    goto done;
+  }
+
+  for (int v = 0; v < n; v++) {
+    index[v] = -1;
+  }
+  int next_index = 0, scc_top = 0;
+  for (int root = 0; root < n; root++) {
+    if (index[root] != -1) {
+      continue;
+    }
+    int depth = 0;
+    call_stack[depth++] = root;
+    index[root] = low[root] = next_index++;
+    cursor[root] = graph.out_offsets[root];
+    scc_stack[scc_top++] = root;
+    on_stack[root] = 1;
+
+    while (depth > 0) {
+      int v = call_stack[depth - 1];
+      if (cursor[v] < graph.out_offsets[v + 1]) {
+        int u = graph.out_targets[cursor[v]++];
+        if (index[u] == -1) {
+          index[u] = low[u] = next_index++;
+          cursor[u] = graph.out_offsets[u];
+          scc_stack[scc_top++] = u;
+          on_stack[u] = 1;
+          call_stack[depth++] = u;
+        } else if (on_stack[u] && index[u] < low[v]) {
+          low[v] = index[u];
+        }
+        continue;
+      }
+
+      depth--;
+      if (depth > 0 && low[v] < low[call_stack[depth - 1]]) {
+        low[call_stack[depth - 1]] = low[v];
+      }
+      if (low[v] == index[v]) {
+        int member;
+        do {
+          member = scc_stack[--scc_top];
+          on_stack[member] = 0;
+          component[member] = v;
+        } while (member != v);
+        count++;
+      }
+    }
+  }
+
+done:
+  free(index);
+  free(low);
+  free(cursor);
+  free(call_stack);
+  free(scc_stack);
+  free(on_stack);
+  return count;
+}
+
+void kahn_seed_range(int begin, int end, void *context) {
+  (void)context;
+  uint32_t local[KAHN_LOCAL_BUFFER];
+  int used = 0;
+
+  for (int v = begin; v < end; v++) {
+    kahn.remaining[v] = graph.in_offsets[v + 1] - graph.in_offsets[v];
+    if (kahn.remaining[v] == 0) {
+      local[used++] = v;
+      if (used == KAHN_LOCAL_BUFFER) {
+        kahn_flush(local, used);
+        used = 0;
+      }
+    }
+  }
+  kahn_flush(local, used);
+}
+
+void kahn_level_range(int begin, int end, void *context) {
+  (void)context;
+  uint32_t local[KAHN_LOCAL_BUFFER];
+  int used = 0;
+
+  for (int i = kahn.level_begin + begin; i < kahn.level_begin + end; i++) {
+    uint32_t v = kahn.order[i];
+    for (uint32_t e = graph.out_offsets[v]; e < graph.out_offsets[v + 1]; e++) {
+      uint32_t u = graph.out_targets[e];
+      if (__atomic_sub_fetch(&kahn.remaining[u], 1, __ATOMIC_RELAXED) == 0) {
+        local[used++] = u;
+        if (used == KAHN_LOCAL_BUFFER) {
+          kahn_flush(local, used);
+          used = 0;
+        }
+      }
+    }
+  }
+  kahn_flush(local, used);
+}
+
+// Appends a worker's newly freed devices to the order with one atomic add.
+void kahn_flush(const uint32_t *local, int used) {
+  if (used == 0) {
+    return;
+  }
+  int at = __atomic_fetch_add(&kahn.placed, used, __ATOMIC_RELAXED);
+  memcpy(kahn.order + at, local, used * sizeof(uint32_t));
+}
+
+// Level-synchronous Kahn: each level is the set of devices whose last
+// in-link was removed by the previous one, and is processed in parallel.
+// Fills `order` and returns how many devices were placed; fewer than the
+// device count means the rest lie on or behind a cycle, and `remaining`
+// (one int per device) keeps their unresolved in-link counts for
+// find_cycle.
+int parallel_topological_order(uint32_t *order, int *remaining, int *levels) {
+  memset(&kahn, 0, sizeof(kahn));
+  kahn.order = order;
+  kahn.remaining = remaining;
+
+  parallel_for(graph.device_count, kahn_seed_range, NULL);
+  *levels = 0;
+  while (kahn.level_begin < kahn.placed) {
+    int level_end = kahn.placed;
+    parallel_for(level_end - kahn.level_begin, kahn_level_range, NULL);
+    kahn.level_begin = level_end;
+    (*levels)++;
+  }
+  return kahn.placed;
+}
+
+// Every device Kahn could not place still has an unplaced predecessor, so
+// walking predecessors from one of them must come back around a cycle.
+// Writes the cycle in link order and returns its length (0 if none).
+int find_cycle(const int *remaining, uint32_t *cycle) {
+  int n = graph.device_count;
+  int start = -1;
+
+  for (int v = 0; v < n && start == -1; v++) {
+    if (remaining[v] > 0) {
+      start = v;
+    }
+  }
+  if (start == -1) {
+    return 0;
+  }
+
+  int *step = (int *)malloc(n * sizeof(int));
+  if (!step) {
+    return 0;
+  }
+  for (int v = 0; v < n; v++) {
+    step[v] = -1;
+  }
+
+  int length = 0, v = start;
+  while (step[v] == -1) {
+    step[v] = length;
+    cycle[length++] = v;
+    for (uint32_t e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++) {
+      if (remaining[graph.in_sources[e]] > 0) {
+        v = graph.in_sources[e];
+        break;
+      }
+    }
+  }
+
+  // cycle[step[v] ..] is the loop, found walking backwards.
+  int first = step[v];
+  length -= first;
+  memmove(cycle, cycle + first, length * sizeof(uint32_t));
+  for (int i = 0; i < length / 2; i++) {
+    uint32_t swap = cycle[i];
+    cycle[i] = cycle[length - 1 - i];
+    cycle[length - 1 - i] = swap;
+  }
+  free(step);
+  return length;
+}
+
+// Neighbors in the undirected view: the sorted union of a device's out-
+// and in-links without itself. Counts when `out` is NULL.
+uint32_t merge_neighbors(int v, uint32_t *out) {
+  uint32_t i = graph.out_offsets[v], i_end = graph.out_offsets[v + 1];
+  uint32_t j = graph.in_offsets[v], j_end = graph.in_offsets[v + 1];
+  uint32_t count = 0;
+
+  while (i < i_end || j < j_end) {
+    uint32_t u;
+    if (j == j_end || (i < i_end && graph.out_targets[i] < graph.in_sources[j])) {
+      u = graph.out_targets[i++];
+    } else if (i == i_end || graph.in_sources[j] < graph.out_targets[i]) {
+      u = graph.in_sources[j++];
+    } else {
+      // Links both ways are two parallel links: losing one direction
+      // leaves the pair connected, so neither is a bridge.
+      u = graph.out_targets[i++];
+      j++;
+      if (u != (uint32_t)v) {
+        if (out) {
+          out[count] = u;
+        }
+        count++;
+      }
+    }
+    if (u != (uint32_t)v) {
+      if (out) {
+        out[count] = u;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+void undirected_degree_range(int begin, int end, void *context) {
+  (void)context;
+  for (int v = begin; v < end; v++) {
+    cuts.offsets[v + 1] = merge_neighbors(v, NULL);
+  }
+}
+
+void undirected_fill_range(int begin, int end, void *context) {
+  (void)context;
+  for (int v = begin; v < end; v++) {
+    merge_neighbors(v, cuts.neighbors + cuts.offsets[v]);
+  }
+}
+
+int find_root(int v) {
+  while (1) {
+    int parent = __atomic_load_n(&cuts.parent[v], __ATOMIC_RELAXED);
+    if (parent == v) {
+      return v;
+    }
+    int grandparent = __atomic_load_n(&cuts.parent[parent], __ATOMIC_RELAXED);
+    if (grandparent != parent) {
+      // Path halving; losing the race only means less compression.
+      __atomic_compare_exchange_n(&cuts.parent[v], &parent, grandparent, 0, __ATOMIC_RELAXED,
+                                  __ATOMIC_RELAXED);
+    }
+    v = grandparent;
+  }
+}
+
+// Lock-free union: the larger root is linked under the smaller one with a
+// CAS, retrying if another thread relinked it first.
+void union_roots(int a, int b) {
+  while (1) {
+    a = find_root(a);
+    b = find_root(b);
+    if (a == b) {
+      return;
+    }
+    if (a < b) {
+      int swap = a;
+      a = b;
+      b = swap;
+    }
+    int expected = a;
+    if (__atomic_compare_exchange_n(&cuts.parent[a], &expected, b, 0, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_SEQ_CST)) {
+      return;
+    }
+  }
+}
+
+void union_range(int begin, int end, void *context) {
+  (void)context;
+  for (int v = begin; v < end; v++) {
+    for (uint32_t e = cuts.offsets[v]; e < cuts.offsets[v + 1]; e++) {
+      if ((int)cuts.neighbors[e] > v) {
+        union_roots(v, cuts.neighbors[e]);
+      }
+    }
+  }
+}
+
+void root_range(int begin, int end, void *context) {
+  (void)context;
+  for (int v = begin; v < end; v++) {
+    __atomic_store_n(&cuts.parent[v], find_root(v), __ATOMIC_RELAXED);
+  }
+}
+
+// Hopcroft-Tarjan low-link DFS over one connected component, iteratively.
+// Components share no devices, so tasks write disjoint parts of the
+// per-device arrays.
+void cut_task(void *arg) {
+  int root = (int)(intptr_t)arg;
+  int time = 0, depth = 0, root_children = 0;
+  int *stack = cuts.stack; // each component owns its own slice
+
+  cuts.discovered[root] = cuts.low[root] = ++time;
+  cuts.tree_parent[root] = -1;
+  cuts.cursor[root] = cuts.offsets[root];
+  stack[cuts.component_start[root] + depth++] = root;
+
+  while (depth > 0) {
+    int v = stack[cuts.component_start[root] + depth - 1];
+    if (cuts.cursor[v] < cuts.offsets[v + 1]) {
+      int u = cuts.neighbors[cuts.cursor[v]++];
+      if (cuts.discovered[u] == 0) {
+        cuts.discovered[u] = cuts.low[u] = ++time;
+        cuts.tree_parent[u] = v;
+        cuts.parent_skipped[u] = 0;
+        cuts.cursor[u] = cuts.offsets[u];
+        stack[cuts.component_start[root] + depth++] = u;
+        if (v == root) {
+          root_children++;
+        }
+      } else if (u == cuts.tree_parent[v] && !cuts.parent_skipped[v]) {
+        // Only the tree link itself; a parallel link to the parent is a back link.
+        cuts.parent_skipped[v] = 1;
+      } else if (cuts.discovered[u] < cuts.low[v]) {
+        cuts.low[v] = cuts.discovered[u];
+      }
+      continue;
+    }
+
+    depth--;
+    int parent = cuts.tree_parent[v];
+    if (parent == -1) {
+      continue;
+    }
+    if (cuts.low[v] < cuts.low[parent]) {
+      cuts.low[parent] = cuts.low[v];
+    }
+    if (cuts.low[v] > cuts.discovered[parent]) {
+      int at = __atomic_fetch_add(&cuts.bridge_count, 1, __ATOMIC_RELAXED);
+      cuts.bridges[2 * at] = parent;
+      cuts.bridges[2 * at + 1] = v;
+    }
+    if (parent != root && cuts.low[v] >= cuts.discovered[parent]) {
+      cuts.is_cut[parent] = 1;
+    }
+  }
+  if (root_children >= 2) {
+    cuts.is_cut[root] = 1;
+  }
+}
+
+// Articulation points and bridges of the undirected view of the graph:
+// devices and links whose loss disconnects part of the fleet. Components
+// are found with a parallel union-find, then each is searched as its own
+// task. Only the view and the components are built in parallel; each
+// search is sequential, so a fleet that is one big component gets its
+// cut analysis on a single thread. Fills `is_cut` (one byte per device) and `bridges`
+// (pairs, room for 2 * device_count) and returns the number of articulation
+// points, or -1 if out of memory.
+int parallel_cut_analysis(unsigned char *is_cut, uint32_t *bridges, int *bridge_count) {
+  int n = graph.device_count;
+  int result = -1;
+
+  memset(&cuts, 0, sizeof(cuts));
+  cuts.is_cut = is_cut;
+  cuts.bridges = bridges;
+  memset(is_cut, 0, n);
+  cuts.offsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+  cuts.parent = (int *)malloc((n + 1) * sizeof(int));
+  cuts.component_start = (int *)calloc(n + 1, sizeof(int));
+  cuts.discovered = (int *)calloc(n + 1, sizeof(int));
+  cuts.low = (int *)malloc((n + 1) * sizeof(int));
+  cuts.tree_parent = (int *)malloc((n + 1) * sizeof(int));
+  cuts.parent_skipped = (unsigned char *)malloc(n + 1);
+  cuts.cursor = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  cuts.stack = (int *)malloc((n + 1) * sizeof(int));
+  if (!cuts.offsets || !cuts.parent || !cuts.component_start || !cuts.discovered || !cuts.low ||
+      !cuts.tree_parent || !cuts.parent_skipped || !cuts.cursor || !cuts.stack) {
+    goto done;
+  }
+
+  parallel_for(n, undirected_degree_range, NULL);
+  for (int v = 0; v < n; v++) {
+    cuts.offsets[v + 1] += cuts.offsets[v];
+  }
+  cuts.neighbors = (uint32_t *)malloc(cuts.offsets[n] * sizeof(uint32_t) + 1);
+  if (!cuts.neighbors) {
+    goto done;
+  }
+  parallel_for(n, undirected_fill_range, NULL);
+
+  for (int v = 0; v < n; v++) {
+    cuts.parent[v] = v;
+  }
+  parallel_for(n, union_range, NULL);
+  parallel_for(n, root_range, NULL);
+
+  // Give each component a contiguous stretch of the DFS stack, sized by a
+  // counting pass over the roots.
+  for (int v = 0; v < n; v++) {
+    cuts.component_start[cuts.parent[v]]++;
+  }
+  int components = 0, position = 0;
+  for (int v = 0; v < n; v++) {
+    if (cuts.parent[v] == v) {
+      int size = cuts.component_start[v];
+      cuts.component_start[v] = position;
+      position += size;
+      if (size >= 2) {
+        cuts.stack[components++] = v; // borrowed as the root list for now
+      }
+    }
+  }
+  int *roots = (int *)malloc((components + 1) * sizeof(int));
+  if (!roots) {
+    goto done;
+  }
+  memcpy(roots, cuts.stack, components * sizeof(int));
+  for (int c = 0; c < components; c++) {
+    pool_submit(cut_task, (void *)(intptr_t)roots[c]);
+  }
+  pool_wait();
+  free(roots);
+
+  *bridge_count = cuts.bridge_count;
+  result = 0;
+  for (int v = 0; v < n; v++) {
+    result += is_cut[v];
+  }
+
+done:
+  free(cuts.offsets);
+  free(cuts.neighbors);
+  free(cuts.parent);
+  free(cuts.component_start);
+  free(cuts.discovered);
+  free(cuts.low);
+  free(cuts.tree_parent);
+  free(cuts.parent_skipped);
+  free(cuts.cursor);
+  free(cuts.stack);
+  return result;
+}
+
+double elapsed_ms(const struct timespec *begin) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+// Runs the three analyses on the loaded graph and prints what they found.
+void run_analytics(int threads) {
+  int n = graph.device_count;
+  int *component = (int *)malloc((n + 1) * sizeof(int));
+  int *remaining = (int *)malloc((n + 1) * sizeof(int));
+  uint32_t *order = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  uint32_t *bridges = (uint32_t *)malloc((2 * (size_t)n + 1) * sizeof(uint32_t));
+  unsigned char *is_cut = (unsigned char *)malloc(n + 1);
+  struct timespec begin;
+
+  if (!component || !remaining || !order || !bridges || !is_cut || !pool_start(threads)) {
+    printf("Error: Out of memory\n");
+    goto done;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  int sccs = parallel_scc(component);
+  double scc_ms = elapsed_ms(&begin);
+  if (sccs >= 0) {
+    // Component IDs are member devices, so count sizes in `remaining`.
+    memset(remaining, 0, n * sizeof(int));
+    int largest = 0, nontrivial = 0;
+    for (int v = 0; v < n; v++) {
+      int size = ++remaining[component[v]];
+      if (size > largest) {
+        largest = size;
+      }
+      nontrivial += size == 2;
+    }
+    printf("\nStrongly connected components: %d (%d with more than one device, largest %d) "
+           "in %.1f ms\n",
+           sccs, nontrivial, largest, scc_ms);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  int levels;
+  int placed = parallel_topological_order(order, remaining, &levels);
+  double topo_ms = elapsed_ms(&begin);
+  if (placed == n) {
+    printf("Topological order: acyclic, %d levels in %.1f ms; starts ", levels, topo_ms);
+    for (int i = 0; i < n && i < CUT_PRINT_LIMIT; i++) {
+      printf("%s ", device_name(order[i]));
+    }
+    printf("\n");
+  } else {
+    int length = find_cycle(remaining, order);
+    printf("Topological order: %d of %d devices placed in %.1f ms; the rest are on or behind "
+           "a cycle, e.g. ",
+           placed, n, topo_ms);
+    for (int i = 0; i < length && i < CUT_PRINT_LIMIT; i++) {
+      printf("%s -> ", device_name(order[i]));
+    }
+    printf("%s\n", length > CUT_PRINT_LIMIT ? "..." : device_name(order[0]));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  int bridge_count = 0;
+  int cut_points = parallel_cut_analysis(is_cut, bridges, &bridge_count);
+  double cut_ms = elapsed_ms(&begin);
+  if (cut_points >= 0) {
+    printf("Single points of failure: %d devices, %d links in %.1f ms\n", cut_points,
+           bridge_count, cut_ms);
+    printf("  Devices: ");
+    int printed = 0;
+    for (int v = 0; v < n && printed < CUT_PRINT_LIMIT; v++) {
+      if (is_cut[v]) {
+        printf("%s ", device_name(v));
+        printed++;
+      }
+    }
+    printf("%s\n  Links: ", cut_points > printed ? "..." : printed ? "" : "None");
+    for (int b = 0; b < bridge_count && b < CUT_PRINT_LIMIT; b++) {
+      printf("%s-%s ", device_name(bridges[2 * b]), device_name(bridges[2 * b + 1]));
+    }
+    printf("%s\n", bridge_count > CUT_PRINT_LIMIT ? "..." : bridge_count ? "" : "None");
+  }
+  if (sccs < 0 || cut_points < 0) {
+    printf("Error: Out of memory\n");
+  }
+  pool_stop();
+
+done:
+  fflush(stdout);
+  free(component);
+  free(remaining);
+  free(order);
+  free(bridges);
+  free(is_cut);
+}
+
+// Whether two component labelings group the devices the same way; `map`
+// is scratch for one int per device.
+int same_partition(const int *a, const int *b, int n, int *map) {
+  for (int v = 0; v < n; v++) {
+    map[v] = -1;
+  }
+  for (int v = 0; v < n; v++) {
+    if (map[a[v]] == -1) {
+      map[a[v]] = b[v];
+    } else if (map[a[v]] != b[v]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+uint64_t next_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Mostly short forward links between nearby devices, with one in ten going
+// anywhere: a large SCC, DAG-like fringes and a few thin attachments. An
+// acyclic fleet points every link from the lower device number up.
+void generate_fleet(int devices_wanted, long links, int acyclic) {
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+  for (long e = 0; e < links; e++) {
+    uint32_t from = next_random(&state) % devices_wanted;
+    uint32_t to;
+    if (next_random(&state) % 10 == 0) {
+      to = next_random(&state) % devices_wanted;
+    } else {
+      to = from + 1 + next_random(&state) % 64;
+      if (to >= (uint32_t)devices_wanted) {
+        to = next_random(&state) % devices_wanted;
+      }
+    }
+    if (acyclic && from >= to) {
+      if (from == to) {
+        continue;
+      }
+      uint32_t swap = from;
+      from = to;
+      to = swap;
+    }
+    if (!queue_link(from, to)) {
+      break;
+    }
+  }
+}
+
+// Synthetic fleets of 10^5 links and up (8 links per device), cyclic and
+// acyclic, each analysis timed at 1, 2, 4, ... up to `max_threads` workers.
+void run_analytics_benchmark(long max_links, int max_threads) {
+  printf("%10s %8s %9s %7s %10s %10s %10s %10s %8s\n", "Links", "Shape", "Devices", "Threads",
+         "Tarjan ms", "SCC ms", "Topo ms", "Cuts ms", "Speedup");
+
+  for (long run = 0; run < 2 * 8; run++) {
+    long links = BENCH_MIN_LINKS;
+    for (long i = 0; i < run / 2; i++) {
+      links *= 10;
+    }
+    if (links > max_links) {
+      break;
+    }
+    int acyclic = run % 2;
+    int n = (int)(links / 8);
+    generate_fleet(n, links, acyclic);
+    if (!build_graph(n)) {
+      return;
+    }
+
+    int *reference = (int *)malloc((n + 1) * sizeof(int));
+    int *component = (int *)malloc((n + 1) * sizeof(int));
+    int *remaining = (int *)malloc((n + 1) * sizeof(int));
+    uint32_t *order = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *bridges = (uint32_t *)malloc((2 * (size_t)n + 1) * sizeof(uint32_t));
+    unsigned char *is_cut = (unsigned char *)malloc(n + 1);
+    if (!reference || !component || !remaining || !order || !bridges || !is_cut) {
+      printf("Error: Out of memory\n");
+      free(reference);
+      free(component);
+      free(remaining);
+      free(order);
+      free(bridges);
+      free(is_cut);
+      return;
+    }
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int expected = tarjan_scc(reference);
+    double tarjan_ms = elapsed_ms(&begin);
+    double baseline = 0;
+    int expected_cuts = -1, expected_bridges = -1, expected_placed = -1;
+
+    int threads = 1;
+    while (1) {
+      if (!pool_start(threads)) {
+        printf("Error: Could not start %d threads\n", threads);
+        break;
+      }
+      int levels, bridge_count = 0;
+
+      clock_gettime(CLOCK_MONOTONIC, &begin);
+      int sccs = parallel_scc(component);
+      double scc_ms = elapsed_ms(&begin);
+
+      clock_gettime(CLOCK_MONOTONIC, &begin);
+      int placed = parallel_topological_order(order, remaining, &levels);
+      double topo_ms = elapsed_ms(&begin);
+
+      clock_gettime(CLOCK_MONOTONIC, &begin);
+      int cut_points = parallel_cut_analysis(is_cut, bridges, &bridge_count);
+      double cut_ms = elapsed_ms(&begin);
+      pool_stop();
+
+      double total = scc_ms + topo_ms + cut_ms;
+      if (threads == 1) {
+        baseline = total;
+        expected_cuts = cut_points;
+        expected_bridges = bridge_count;
+        expected_placed = placed;
+      }
+      printf("%10ld %8s %9d %7d %10.1f %10.1f %10.1f %10.1f %7.2fx%s\n", links,
+             acyclic ? "acyclic" : "cyclic", n, threads, tarjan_ms, scc_ms, topo_ms, cut_ms,
+             baseline / total,
+             sccs != expected || !same_partition(reference, component, n, remaining) ||
+                     cut_points != expected_cuts || bridge_count != expected_bridges ||
+                     placed != expected_placed || (acyclic && placed != n)
+                 ? "  MISMATCH"
+                 : "");
+      fflush(stdout);
+      if (threads == max_threads) {
+        break;
+      }
+      threads = threads * 2 < max_threads ? threads * 2 : max_threads;
+    }
+
+    free(reference);
+    free(component);
+    free(remaining);
+    free(order);
+    free(bridges);
+    free(is_cut);
+    free_graph();
+  }
+}
+
+// Relabels the dynamic graph's components from scratch and checks them
+// against the maintained labels, sizes and count.
+int check_components() {
+  DynamicGraph *g = &dynamic;
+  unsigned char *label_seen = (unsigned char *)calloc(g->capacity + 1, 1);
+  int *visited = (int *)calloc(g->capacity + 1, sizeof(int));
+  int ok = label_seen && visited;
+  int components = 0;
+
+  for (int root = 0; ok && root < g->device_count; root++) {
+    if (!g->alive[root] || visited[root]) {
+      continue;
+    }
+    int label = g->component[root];
+    ok = !label_seen[label];
+    label_seen[label] = 1;
+    components++;
+
+    int head = 0, tail = 0;
+    g->queue[tail++] = root;
+    visited[root] = 1;
+    while (ok && head < tail) {
+      int v = g->queue[head++];
+      ok = g->component[v] == label;
+      const LinkList *lists[2] = {&g->out[v], &g->in[v]};
+      for (int side = 0; side < 2; side++) {
+        for (uint32_t e = 0; e < lists[side]->count; e++) {
+          int w = (int)lists[side]->entries[e].device;
+          if (!visited[w]) {
+            visited[w] = 1;
+            g->queue[tail++] = w;
+          }
+        }
+      }
+    }
+    ok = ok && g->component_size[label] == tail;
+  }
+
+  free(label_seen);
+  free(visited);
+  return ok && components == g->component_count;
+}
+
+// Random link and device churn against a synthetic fleet of CHURN_LINKS
+// links: mostly link inserts and deletes, with some devices joining and
+// leaving. Reports throughput per kind of update against a full CSR
+// rebuild, then verifies the maintained components from scratch.
+void run_churn_benchmark(long updates) {
+  int n = (int)(CHURN_LINKS / 8);
+  char from[MAX_DEVICE_ID], to[MAX_DEVICE_ID];
+
+  for (int i = 0; i < n; i++) {
+    snprintf(from, sizeof(from), "D%07d", i);
+    if (add_device(from) == -1) {
+      printf("Error: Out of memory\n");
+      return;
+    }
+  }
+  generate_fleet(n, CHURN_LINKS, 0);
+  if (!build_graph(n)) {
+    return;
+  }
+
+  struct timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  if (!start_dynamic()) {
+    printf("Error: Out of memory\n");
+    return;
+  }
+  double start_ms = elapsed_ms(&begin);
+  printf("Fleet: %d devices, %u links, %d components (lists built in %.1f ms)\n", n,
+         graph.edge_count, dynamic.component_count, start_ms);
+
+  const char *kinds[4] = {"link +", "link -", "join", "leave"};
+  double kind_ms[4] = {0};
+  long kind_count[4] = {0};
+  UpdateCounts counts = {0};
+  uint64_t state = 0x2545F4914F6CDD1DULL;
+  long next_name = 0;
+
+  for (long i = 0; i < updates; i++) {
+    uint64_t roll = next_random(&state) % 100;
+    int kind = roll < 45 ? 0 : roll < 90 ? 1 : roll < 95 ? 2 : 3;
+    int a = (int)(next_random(&state) % dynamic.device_count);
+
+    // Pick the operands before starting the clock.
+    if (kind == 0) {
+      int b = (int)(next_random(&state) % dynamic.device_count);
+      snprintf(from, sizeof(from), "%s", device_name(a));
+      snprintf(to, sizeof(to), "%s", device_name(b));
+    } else if (kind == 1) {
+      for (int tries = 0; tries < 16 && dynamic.out[a].count == 0; tries++) {
+        a = (int)(next_random(&state) % dynamic.device_count);
+      }
+      if (dynamic.out[a].count == 0) {
+        continue;
+      }
+      const LinkList *out = &dynamic.out[a];
+      snprintf(from, sizeof(from), "%s", device_name(a));
+      snprintf(to, sizeof(to), "%s",
+               device_name(out->entries[next_random(&state) % out->count].device));
+    } else if (kind == 2) {
+      snprintf(from, sizeof(from), "N%07ld", next_name++);
+    } else {
+      snprintf(from, sizeof(from), "%s", device_name(a));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int result = apply_update(kind % 2 ? '-' : '+', from, kind < 2 ? to : NULL, &counts);
+    kind_ms[kind] += elapsed_ms(&begin);
+    kind_count[kind]++;
+    if (result == -1) {
+      printf("Error: Out of memory\n");
+      break;
+    }
+  }
+
+  double total_ms = 0;
+  long total = 0;
+  printf("%8s %10s %12s %10s\n", "Update", "Count", "Updates/s", "ns each");
+  for (int k = 0; k < 4; k++) {
+    total_ms += kind_ms[k];
+    total += kind_count[k];
+    printf("%8s %10ld %12.0f %10.0f\n", kinds[k], kind_count[k],
+           kind_ms[k] > 0 ? kind_count[k] / (kind_ms[k] / 1e3) : 0.0,
+           kind_count[k] ? kind_ms[k] * 1e6 / kind_count[k] : 0.0);
+  }
+  printf("%8s %10ld %12.0f %10.0f\n", "all", total, total_ms > 0 ? total / (total_ms / 1e3) : 0.0,
+         total ? total_ms * 1e6 / total : 0.0);
+  printf("Graph now: %d devices, %llu links, %d components; maintained components %s\n",
+         dynamic.alive_count, (unsigned long long)dynamic.edge_count, dynamic.component_count,
+         check_components() ? "verified" : "MISMATCH");
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  if (sync_graph()) {
+    printf("One full CSR rebuild: %.1f ms\n", elapsed_ms(&begin));
+  }
+  free_graph();
+}
+
+int main(int argc, char *argv[]) {
+  const char *edge_path = NULL;
+  const char *update_path = NULL;
+  const char *graph_path = NULL;
+  const char *compile_path = NULL;
+  long bench_links = 0;
+  long churn_updates = 0;
+  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+      edge_path = argv[++i];
+    } else if (strcmp(argv[i], "--bitset") == 0) {
+      use_bitset = 1;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--bench") == 0) {
+      bench_links = (i + 1 < argc && argv[i + 1][0] != '-') ? atol(argv[++i])
+                                                             : DEFAULT_BENCH_MAX_LINKS;
+    } else if (strcmp(argv[i], "--graph") == 0 && i + 1 < argc) {
+      graph_path = argv[++i];
+    } else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+      edge_path = argv[++i];
+      compile_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : DEFAULT_GRAPH_FILE;
+    } else if (strcmp(argv[i], "--updates") == 0 && i + 1 < argc) {
+      update_path = argv[++i];
+    } else if (strcmp(argv[i], "--churn") == 0) {
+      churn_updates = (i + 1 < argc && argv[i + 1][0] != '-') ? atol(argv[++i])
+                                                               : DEFAULT_CHURN_UPDATES;
+    } else {
+      printf("Usage: %s [--load EDGE_LIST | --graph SNAPSHOT] [--updates FILE|-] [--bitset] "
+             "[--threads N]\n       %s --compile EDGE_LIST [SNAPSHOT]\n"
+             "       %s --bench [MAX_LINKS] | --churn [UPDATES]\n",
+             argv[0], argv[0],
+             argv[0]);
+      return 1;
+    }
+  }
+  if (threads < 1) {
+    threads = 1;
+  } else if (threads > MAX_THREADS) {
+    threads = MAX_THREADS;
+  }
+
+  if (bench_links > 0) {
+    run_analytics_benchmark(bench_links, threads);
+    return 0;
+  }
+  if (churn_updates > 0) {
+    run_churn_benchmark(churn_updates);
+    return 0;
+  }
+  if (compile_path) {
+    return compile_graph_snapshot(edge_path, compile_path) ? 0 : 1;
+  }
+
+  printf("IoT Device Communication Tool\n");
+
+  struct timespec begin, end;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  if (graph_path) {
+    if (!open_graph_snapshot(graph_path)) {
+      return 1;
+    }
+  } else if (edge_path) {
+    if (!load_edge_list(edge_path)) {
+      return 1;
+    }
+  } else {
+    for (int i = 1; i <= 8; i++) {
+      char device_id[MAX_DEVICE_ID];
+      snprintf(device_id, sizeof(device_id), "D%03d", i);
+      add_device(device_id);
+    }
+    add_connection("D001", "D002");
+    add_connection("D001", "D003");
+    add_connection("D002", "D004");
+    add_connection("D003", "D005");
+    add_connection("D004", "D005");
+    add_connection("D004", "D006");
+    add_connection("D005", "D007");
+    add_connection("D006", "D008");
+  }
+  if ((!graph_path && !build_graph(devices.count)) || (use_bitset && !build_bitset_graph())) {
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (graph_path || edge_path) {
+    printf("%s %d devices and %u links from %s in %.1f ms\n", graph_path ? "Mapped" : "Loaded",
+           graph.device_count, graph.edge_count, graph_path ? graph_path : edge_path,
+           (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6);
+  }
+  if (use_bitset) {
+    printf("Bitset mode: %.1f MB of adjacency rows\n",
+           2.0 * bitset.device_count * bitset.words * sizeof(uint64_t) / (1024.0 * 1024.0));
+  }
+  if (update_path) {
+    int ok = apply_update_stream(update_path);
+    free_dynamic();
+    free_bitset_graph();
+    free_graph();
+    free_device_table(&devices);
+    graph_snapshot_close(&snapshot);
+    return ok ? 0 : 1;
+  }
+  display_adjacency_matrix();
+
+  char line[MAX_LINE];
+  while (1) {
+    printf("\nEnter device ID, 'common A B', 'reach A K', 'analyze', '+ A [B]', '- A [B]', "
+           "'stats' (or 'exit'): ");
+    fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin)) {
+      break;
+    }
+
+    char command[MAX_DEVICE_ID], first[MAX_DEVICE_ID], second[MAX_DEVICE_ID];
+    int fields = sscanf(line, "%63s %63s %63s", command, first, second);
+    if (fields <= 0) {
+      continue;
+    }
+
+    if (strcmp(command, "exit") == 0) {
+      break;
+    } else if ((strcmp(command, "+") == 0 || strcmp(command, "-") == 0) && fields >= 2) {
+      update_command(command[0], first, fields == 3 ? second : NULL);
+    } else if (strcmp(command, "stats") == 0) {
+      print_dynamic_stats();
+    } else if (strcmp(command, "analyze") == 0) {
+      if (sync_graph()) {
+        run_analytics(threads);
+      }
+    } else if (strcmp(command, "common") == 0 && fields == 3) {
+      if (sync_graph()) {
+        query_common_targets(first, second);
+      }
+    } else if (strcmp(command, "reach") == 0 && fields == 3 && atoi(second) > 0) {
+      if (sync_graph()) {
+        query_reach(first, atoi(second));
+      }
+    } else {
+      query_device_connections(command);
+    }
+  }
+
+  free_dynamic();
+  free_bitset_graph();
+  free_graph();
+  free_device_table(&devices);
+  graph_snapshot_close(&snapshot);
 
   printf("System shutdown.\n");
   return 0;
@@ -1,64 +1,439 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "graph_snapshot.h"
 
-#define MAX_NODES 10
 #define INF INT_MAX
+#define MAX_LINE 256
+#define LOCATIONS_INITIAL 16
+#define ROADS_INITIAL 64
+#define ROAD_SEPARATORS ",\t"
+#define DEFAULT_GRAPH_FILE "roads.graph"
+#define DESTINATION "Emergency Site"
+#define DIAL_MAX_BUCKETS (1 << 20) // longer roads fall back to the heap
+#define BENCH_MIN_NODES 10000
+#define DEFAULT_BENCH_MAX_NODES 1000000
+#define BENCH_LINEAR_MAX_NODES 100000 // the O(V^2) scan is skipped above this
+#define BENCH_SOURCES 5
+#define BENCH_MAX_MINUTES 15
+#define BENCH_ROUTES 50
+#define ALT_LANDMARKS 8
+
+enum { QUEUE_HEAP, QUEUE_DIAL, QUEUE_LINEAR };
+enum { ROUTE_FULL, ROUTE_EARLY_EXIT, ROUTE_BIDIRECTIONAL, ROUTE_ASTAR };
+
+// Location names stored back to back in one arena and looked up through an
+// open-addressing hash table, laid out like the name sections of a graph
+// snapshot so the built graph can point straight at them.
+typedef struct {
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+    uint32_t* offsets;
+    int count;
+    int capacity;
+    uint32_t* table; // location number + 1, 0 = empty
+    uint32_t table_mask;
+} LocationTable;
+
+// Roads collected while loading, before the graph is built.
+typedef struct {
+    uint32_t* from;
+    uint32_t* to;
+    uint32_t* time;
+    size_t count;
+    size_t capacity;
+} RoadList;
+
+// Binary min-heap of locations keyed by tentative distance. Each
+// location's slot in the heap is tracked, so a shorter distance moves it
+// up in O(log n) instead of queueing a duplicate.
+typedef struct {
+    int* nodes;     // heap order
+    int* slot;      // index of each location in `nodes`, -1 if not queued
+    const int* key; // the distance array
+    int size;
+} IndexedHeap;
+
+// Dial's bucket queue. With travel times of at most C minutes, every
+// queued distance lies within C of the smallest, so C + 1 buckets used
+// cyclically (distance d goes to bucket d % (C + 1)) hold the whole
+// frontier. Buckets are doubly linked lists threaded through per-location
+// arrays, so lowering a distance moves a location in O(1).
+typedef struct {
+    int* head; // first location per bucket, -1 = empty
+    int* next;
+    int* prev;
+    int bucket_count;
+    int queued;
+} BucketQueue;
+
+// One direction of a point-to-point search. Entries count only where
+// `stamp` matches the current query, so a query pays for the locations it
+// touches rather than for clearing arrays the size of the city.
+typedef struct {
+    int* dist;
+    int* prev;
+    int* priority; // heap key: distance, plus the landmark bound for A*
+    uint32_t* stamp;
+    char* done; // settled
+    IndexedHeap heap;
+} SearchSide;
+
+// Reused by every find_route call: a forward side from the start, a
+// backward side from the end, and the ALT landmark distance tables
+// (landmark_count rows of node_count entries each).
+typedef struct {
+    SearchSide sides[2];
+    uint32_t query;
+    long settled; // locations settled by the last query
+    int landmark_count;
+    int* landmarks;
+    int* from_landmark;
+    int* to_landmark; // the same table as from_landmark on undirected graphs
+} RouteWorkspace;
+
+LocationTable locations = {0};
+RoadList roads = {0};
 
-const char* locations[MAX_NODES] = {
-    "Dispatch Center", "Sector A", "Sector B", "Sector D",
-    "Emergency Site", "Junction C", "Sector E"
-};
+// The road network in graph snapshot layout: node i's roads lead to
+// out_targets[out_offsets[i] .. out_offsets[i + 1]) with travel times in
+// `weights`, each road listed from both ends. The arrays are either built
+// from `roads` or point into a mapped --graph file.
+GraphSnapshot road_graph = {0};
+int longest_road = -1; // cached by max_road_time
+RouteWorkspace workspace = {0};
 
-int adj_matrix[MAX_NODES][MAX_NODES];
-int node_count = 7;
+void free_workspace();
+
+const char* location_name(int index) {
+    return road_graph.names + road_graph.name_offsets[index];
+}
 
 int find_location_index(const char* location) {
-    for (int i = 0; i < node_count; i++) {
-        if (strcmp(locations[i], location) == 0) {
-            return i;
+    return graph_find_node(&road_graph, location);
+}
+
+// Returns the location's number, registering it if it is new, or -1 if out
+// of memory.
+int add_location(const char* location) {
+    if (locations.table) {
+        uint32_t bucket = graph_hash_name(location) & locations.table_mask;
+        while (locations.table[bucket]) {
+            int index = locations.table[bucket] - 1;
+            if (strcmp(locations.arena + locations.offsets[index], location) == 0) {
+                return index;
+            }
+            bucket = (bucket + 1) & locations.table_mask;
+        }
+    }
+
+    size_t length = strlen(location);
+    if (locations.arena_size + length + 1 > locations.arena_capacity) {
+        size_t capacity = locations.arena_capacity ? locations.arena_capacity : MAX_LINE;
+        while (locations.arena_size + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(locations.arena, capacity);
+        if (!grown) return -1;
+        locations.arena = grown;
+        locations.arena_capacity = capacity;
+    }
+
+    if (locations.count == locations.capacity) {
+        int capacity = locations.capacity ? locations.capacity * 2 : LOCATIONS_INITIAL;
+        uint32_t* offsets = (uint32_t*)realloc(locations.offsets, capacity * sizeof(uint32_t));
+        if (!offsets) return -1;
+        locations.offsets = offsets;
+        locations.capacity = capacity;
+
+        // Keep the hash table at most half full.
+        uint32_t mask = 2 * (uint32_t)capacity - 1;
+        uint32_t* table = (uint32_t*)calloc((size_t)mask + 1, sizeof(uint32_t));
+        if (!table) return -1;
+        for (int i = 0; i < locations.count; i++) {
+            uint32_t bucket = graph_hash_name(locations.arena + locations.offsets[i]) & mask;
+            while (table[bucket]) {
+                bucket = (bucket + 1) & mask;
+            }
+            table[bucket] = i + 1;
+        }
+        free(locations.table);
+        locations.table = table;
+        locations.table_mask = mask;
+    }
+
+    memcpy(locations.arena + locations.arena_size, location, length + 1);
+    locations.offsets[locations.count] = (uint32_t)locations.arena_size;
+    locations.arena_size += length + 1;
+
+    uint32_t bucket = graph_hash_name(location) & locations.table_mask;
+    while (locations.table[bucket]) {
+        bucket = (bucket + 1) & locations.table_mask;
+    }
+    locations.table[bucket] = locations.count + 1;
+    return locations.count++;
+}
+
+// Queues a two-way road for build_road_graph, registering unknown
+// locations.
+int add_road(const char* from, const char* to, int time) {
+    int from_idx = add_location(from);
+    int to_idx = add_location(to);
+
+    if (from_idx == -1 || to_idx == -1 || time < 0) {
+        return 0;
+    }
+
+    if (roads.count == roads.capacity) {
+        size_t capacity = roads.capacity ? roads.capacity * 2 : ROADS_INITIAL;
+        uint32_t* from_grown = (uint32_t*)realloc(roads.from, capacity * sizeof(uint32_t));
+        if (!from_grown) return 0;
+        roads.from = from_grown;
+        uint32_t* to_grown = (uint32_t*)realloc(roads.to, capacity * sizeof(uint32_t));
+        if (!to_grown) return 0;
+        roads.to = to_grown;
+        uint32_t* time_grown = (uint32_t*)realloc(roads.time, capacity * sizeof(uint32_t));
+        if (!time_grown) return 0;
+        roads.time = time_grown;
+        roads.capacity = capacity;
+    }
+
+    roads.from[roads.count] = (uint32_t)from_idx;
+    roads.to[roads.count] = (uint32_t)to_idx;
+    roads.time[roads.count] = (uint32_t)time;
+    roads.count++;
+    return 1;
+}
+
+char* trim(char* text) {
+    text += strspn(text, " \r\n");
+    size_t length = strlen(text);
+    while (length > 0 && strchr(" \r\n", text[length - 1])) {
+        text[--length] = '\0';
+    }
+    return text;
+}
+
+// Reads one road per line, "FROM,TO,MINUTES" (tabs also separate, so
+// location names may contain spaces). Blank lines and lines starting with
+// '#' are skipped. Each road becomes a link in both directions, so all
+// times together may come to half of GRAPH_MAX_TOTAL_WEIGHT.
+int load_roads(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Error: Could not open %s\n", path);
+        return 0;
+    }
+
+    char line[MAX_LINE];
+    long line_number = 0;
+    uint64_t total_time = 0;
+    int ok = 1;
+
+    while (ok && fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* fields[3];
+        char* cursor = line;
+        int count = 0;
+        while (count < 3) {
+            fields[count++] = cursor;
+            size_t length = strcspn(cursor, ROAD_SEPARATORS);
+            if (cursor[length] == '\0') break;
+            cursor[length] = '\0';
+            cursor += length + 1;
+        }
+        for (int i = 0; i < count; i++) {
+            fields[i] = trim(fields[i]);
+        }
+        if (*fields[0] == '\0' || *fields[0] == '#') continue;
+
+        char* end = NULL;
+        long time = count == 3 ? strtol(fields[2], &end, 10) : -1;
+        if (count != 3 || *fields[1] == '\0' || end == fields[2] || *end != '\0' || time < 0 ||
+            time > INT_MAX) {
+            printf("Error: Expected FROM,TO,MINUTES at line %ld of %s\n", line_number, path);
+            ok = 0;
+        } else if ((total_time += (uint64_t)time) > GRAPH_MAX_TOTAL_WEIGHT / 2) {
+            printf("Error: Road times add up to more than %d minutes at line %ld of %s\n",
+                   GRAPH_MAX_TOTAL_WEIGHT / 2, line_number, path);
+            ok = 0;
+        } else if (!add_road(fields[0], fields[1], (int)time)) {
+            printf("Error: Out of memory at line %ld of %s\n", line_number, path);
+            ok = 0;
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+int compare_links(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Turns the queued roads into CSR rows listing each road from both ends.
+// Each row is sorted by destination (then time) and repeated roads keep
+// the shortest time. The road list is released afterwards.
+int build_road_graph() {
+    uint32_t n = (uint32_t)locations.count;
+    size_t m = 2 * roads.count;
+
+    if (m > UINT32_MAX) {
+        printf("Error: Too many roads (%zu)\n", roads.count);
+        return 0;
+    }
+
+    uint32_t* offsets = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+    uint64_t* links = (uint64_t*)malloc(m * sizeof(uint64_t) + 1);
+    uint32_t* cursor = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    if (!offsets || !links || !cursor) {
+        free(offsets);
+        free(links);
+        free(cursor);
+        printf("Error: Out of memory building graph\n");
+        return 0;
+    }
+
+    for (size_t r = 0; r < roads.count; r++) {
+        offsets[roads.from[r] + 1]++;
+        offsets[roads.to[r] + 1]++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    memcpy(cursor, offsets, (n + 1) * sizeof(uint32_t));
+    // Destination in the high half so sorting a row orders by destination.
+    for (size_t r = 0; r < roads.count; r++) {
+        links[cursor[roads.from[r]]++] = (uint64_t)roads.to[r] << 32 | roads.time[r];
+        links[cursor[roads.to[r]]++] = (uint64_t)roads.from[r] << 32 | roads.time[r];
+    }
+    free(cursor);
+    free(roads.from);
+    free(roads.to);
+    free(roads.time);
+    memset(&roads, 0, sizeof(roads));
+
+    uint32_t write = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t begin = offsets[i];
+        uint32_t end = offsets[i + 1];
+        qsort(links + begin, end - begin, sizeof(uint64_t), compare_links);
+        offsets[i] = write;
+        for (uint32_t e = begin; e < end; e++) {
+            if (e == begin || links[e] >> 32 != links[e - 1] >> 32) {
+                links[write++] = links[e];
+            }
         }
     }
-    return -1;
+    offsets[n] = write;
+
+    uint32_t* targets = (uint32_t*)malloc(write * sizeof(uint32_t) + 1);
+    uint32_t* times = (uint32_t*)malloc(write * sizeof(uint32_t) + 1);
+    if (!targets || !times) {
+        free(offsets);
+        free(links);
+        free(targets);
+        free(times);
+        printf("Error: Out of memory building graph\n");
+        return 0;
+    }
+    for (uint32_t e = 0; e < write; e++) {
+        targets[e] = (uint32_t)(links[e] >> 32);
+        times[e] = (uint32_t)links[e];
+    }
+    free(links);
+
+    road_graph.flags = GRAPH_WEIGHTED | GRAPH_UNDIRECTED;
+    road_graph.node_count = n;
+    road_graph.edge_count = write;
+    road_graph.names = locations.arena;
+    road_graph.names_size = locations.arena_size;
+    road_graph.name_offsets = locations.offsets;
+    road_graph.name_table = locations.table;
+    road_graph.name_table_mask = locations.table_mask;
+    road_graph.out_offsets = offsets;
+    road_graph.out_targets = targets;
+    road_graph.weights = times;
+    road_graph.in_offsets = offsets;
+    road_graph.in_sources = targets;
+    return 1;
 }
 
-void add_road(const char* from, const char* to, int time) {
-    int from_idx = find_location_index(from);
-    int to_idx = find_location_index(to);
-    
-    if (from_idx != -1 && to_idx != -1) {
-        adj_matrix[from_idx][to_idx] = time;
-        adj_matrix[to_idx][from_idx] = time;
+void free_road_graph() {
+    if (road_graph.mapping) {
+        graph_snapshot_close(&road_graph);
+    } else {
+        free((void*)road_graph.out_offsets);
+        free((void*)road_graph.out_targets);
+        free((void*)road_graph.weights);
+        memset(&road_graph, 0, sizeof(road_graph));
     }
+    free(locations.arena);
+    free(locations.offsets);
+    free(locations.table);
+    memset(&locations, 0, sizeof(locations));
+    longest_road = -1;
+    free_workspace();
 }
 
-void dijkstra(int start, int dist[], int prev[]) {
-    int visited[MAX_NODES] = {0};
-    
+// Travel time of the e-th entry of out_targets; a snapshot without weights
+// (such as a device graph) counts every link as one minute.
+int road_time(uint32_t e) {
+    return road_graph.weights ? (int)road_graph.weights[e] : 1;
+}
+
+int max_road_time() {
+    if (longest_road < 0) {
+        longest_road = road_graph.weights ? 0 : 1;
+        for (uint32_t e = 0; road_graph.weights && e < road_graph.edge_count; e++) {
+            if ((int)road_graph.weights[e] > longest_road) {
+                longest_road = (int)road_graph.weights[e];
+            }
+        }
+    }
+    return longest_road;
+}
+
+// The original search: an O(V) scan for the closest unvisited location on
+// every step, O(V^2) overall. Kept as the benchmark baseline.
+int dijkstra_linear(int start, int dist[], int prev[]) {
+    int node_count = (int)road_graph.node_count;
+    char* visited = (char*)calloc(node_count + 1, 1);
+    if (!visited) return 0;
+
     for (int i = 0; i < node_count; i++) {
         dist[i] = INF;
         prev[i] = -1;
     }
-    
+
     dist[start] = 0;
-    
+
     for (int i = 0; i < node_count; i++) {
         int min_dist = INF;
         int u = -1;
-        
+
         for (int v = 0; v < node_count; v++) {
             if (!visited[v] && dist[v] < min_dist) {
                 min_dist = dist[v];
                 u = v;
             }
         }
-        
+
         if (u == -1) break;
         visited[u] = 1;
-        
-        for (int v = 0; v < node_count; v++) {
-            if (adj_matrix[u][v] > 0 && !visited[v]) {
-                int new_dist = dist[u] + adj_matrix[u][v];
+
+        for (uint32_t e = road_graph.out_offsets[u]; e < road_graph.out_offsets[u + 1]; e++) {
+            int v = (int)road_graph.out_targets[e];
+            if (!visited[v]) {
+                int new_dist = dist[u] + road_time(e);
                 if (new_dist < dist[v]) {
                     dist[v] = new_dist;
                     prev[v] = u;
@@ -66,65 +441,855 @@ void dijkstra(int start, int dist[], int prev[]) {
             }
         }
     }
+    free(visited);
+    return 1;
+}
+
+void heap_sift_up(IndexedHeap* heap, int i) {
+    int node = heap->nodes[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap->key[heap->nodes[parent]] <= heap->key[node]) break;
+        heap->nodes[i] = heap->nodes[parent];
+        heap->slot[heap->nodes[i]] = i;
+        i = parent;
+    }
+    heap->nodes[i] = node;
+    heap->slot[node] = i;
+}
+
+void heap_sift_down(IndexedHeap* heap, int i) {
+    int node = heap->nodes[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= heap->size) break;
+        if (child + 1 < heap->size &&
+            heap->key[heap->nodes[child + 1]] < heap->key[heap->nodes[child]]) {
+            child++;
+        }
+        if (heap->key[heap->nodes[child]] >= heap->key[node]) break;
+        heap->nodes[i] = heap->nodes[child];
+        heap->slot[heap->nodes[i]] = i;
+        i = child;
+    }
+    heap->nodes[i] = node;
+    heap->slot[node] = i;
+}
+
+// Queues `node`, or restores heap order after its key went down.
+void heap_push_or_decrease(IndexedHeap* heap, int node) {
+    if (heap->slot[node] == -1) {
+        heap->nodes[heap->size] = node;
+        heap->slot[node] = heap->size++;
+    }
+    heap_sift_up(heap, heap->slot[node]);
+}
+
+int heap_pop(IndexedHeap* heap) {
+    int top = heap->nodes[0];
+    heap->slot[top] = -1;
+    if (--heap->size > 0) {
+        heap->nodes[0] = heap->nodes[heap->size];
+        heap_sift_down(heap, 0);
+    }
+    return top;
+}
+
+// Dijkstra with an indexed binary heap: O((V + E) log V). Returns 0 if
+// out of memory.
+int dijkstra_heap(int start, int dist[], int prev[]) {
+    int node_count = (int)road_graph.node_count;
+    IndexedHeap heap = {0};
+
+    heap.nodes = (int*)malloc((node_count + 1) * sizeof(int));
+    heap.slot = (int*)malloc((node_count + 1) * sizeof(int));
+    heap.key = dist;
+    if (!heap.nodes || !heap.slot) {
+        free(heap.nodes);
+        free(heap.slot);
+        return 0;
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        dist[i] = INF;
+        prev[i] = -1;
+        heap.slot[i] = -1;
+    }
+
+    dist[start] = 0;
+    heap_push_or_decrease(&heap, start);
+
+    while (heap.size > 0) {
+        int u = heap_pop(&heap);
+        for (uint32_t e = road_graph.out_offsets[u]; e < road_graph.out_offsets[u + 1]; e++) {
+            int v = (int)road_graph.out_targets[e];
+            int new_dist = dist[u] + road_time(e);
+            if (new_dist < dist[v]) {
+                dist[v] = new_dist;
+                prev[v] = u;
+                heap_push_or_decrease(&heap, v);
+            }
+        }
+    }
+
+    free(heap.nodes);
+    free(heap.slot);
+    return 1;
+}
+
+void bucket_insert(BucketQueue* queue, int node, int distance) {
+    int bucket = distance % queue->bucket_count;
+    queue->prev[node] = -1;
+    queue->next[node] = queue->head[bucket];
+    if (queue->head[bucket] != -1) queue->prev[queue->head[bucket]] = node;
+    queue->head[bucket] = node;
+    queue->queued++;
+}
+
+void bucket_remove(BucketQueue* queue, int node, int distance) {
+    int bucket = distance % queue->bucket_count;
+    if (queue->prev[node] != -1) {
+        queue->next[queue->prev[node]] = queue->next[node];
+    } else {
+        queue->head[bucket] = queue->next[node];
+    }
+    if (queue->next[node] != -1) queue->prev[queue->next[node]] = queue->prev[node];
+    queue->queued--;
+}
+
+// Dijkstra over Dial's bucket queue: O(V + E + D) where D is the largest
+// distance reached, since the scan for the next non-empty bucket only ever
+// moves forward. Travel times longer than DIAL_MAX_BUCKETS minutes would
+// make the bucket array too large, so such graphs use the heap instead.
+int dijkstra_dial(int start, int dist[], int prev[]) {
+    int node_count = (int)road_graph.node_count;
+    int longest = max_road_time();
+    BucketQueue queue = {0};
+
+    if (longest >= DIAL_MAX_BUCKETS) {
+        return dijkstra_heap(start, dist, prev);
+    }
+
+    queue.bucket_count = longest + 1;
+    queue.head = (int*)malloc(queue.bucket_count * sizeof(int));
+    queue.next = (int*)malloc((node_count + 1) * sizeof(int));
+    queue.prev = (int*)malloc((node_count + 1) * sizeof(int));
+    if (!queue.head || !queue.next || !queue.prev) {
+        free(queue.head);
+        free(queue.next);
+        free(queue.prev);
+        return 0;
+    }
+
+    for (int b = 0; b < queue.bucket_count; b++) {
+        queue.head[b] = -1;
+    }
+    for (int i = 0; i < node_count; i++) {
+        dist[i] = INF;
+        prev[i] = -1;
+    }
+
+    dist[start] = 0;
+    bucket_insert(&queue, start, 0);
+
+    for (int current = 0; queue.queued > 0; current++) {
+        int bucket = current % queue.bucket_count;
+        while (queue.head[bucket] != -1) {
+            int u = queue.head[bucket];
+            bucket_remove(&queue, u, current);
+            for (uint32_t e = road_graph.out_offsets[u]; e < road_graph.out_offsets[u + 1];
+                 e++) {
+                int v = (int)road_graph.out_targets[e];
+                int new_dist = current + road_time(e);
+                if (new_dist < dist[v]) {
+                    if (dist[v] != INF) bucket_remove(&queue, v, dist[v]);
+                    dist[v] = new_dist;
+                    prev[v] = u;
+                    bucket_insert(&queue, v, new_dist);
+                }
+            }
+        }
+    }
+
+    free(queue.head);
+    free(queue.next);
+    free(queue.prev);
+    return 1;
+}
+
+int dijkstra(int start, int dist[], int prev[], int queue_kind) {
+    if (queue_kind == QUEUE_DIAL) return dijkstra_dial(start, dist, prev);
+    if (queue_kind == QUEUE_LINEAR) return dijkstra_linear(start, dist, prev);
+    return dijkstra_heap(start, dist, prev);
+}
+
+// Whether a backward search can walk the in-rows: on an undirected graph
+// they are the out-rows, and an unweighted one counts every link as one
+// minute. A directed graph with travel times keeps none for its in-rows.
+int reverse_search_possible() {
+    return (road_graph.flags & GRAPH_UNDIRECTED) || !road_graph.weights;
+}
+
+void free_workspace() {
+    for (int s = 0; s < 2; s++) {
+        SearchSide* side = &workspace.sides[s];
+        free(side->dist);
+        free(side->prev);
+        free(side->priority);
+        free(side->stamp);
+        free(side->done);
+        free(side->heap.nodes);
+        free(side->heap.slot);
+    }
+    free(workspace.landmarks);
+    if (workspace.to_landmark != workspace.from_landmark) free(workspace.to_landmark);
+    free(workspace.from_landmark);
+    memset(&workspace, 0, sizeof(workspace));
+}
+
+int prepare_workspace() {
+    int n = (int)road_graph.node_count;
+    if (workspace.sides[0].dist) return 1;
+
+    for (int s = 0; s < 2; s++) {
+        SearchSide* side = &workspace.sides[s];
+        side->dist = (int*)malloc((n + 1) * sizeof(int));
+        side->prev = (int*)malloc((n + 1) * sizeof(int));
+        side->priority = (int*)malloc((n + 1) * sizeof(int));
+        side->stamp = (uint32_t*)calloc(n + 1, sizeof(uint32_t));
+        side->done = (char*)malloc(n + 1);
+        side->heap.nodes = (int*)malloc((n + 1) * sizeof(int));
+        side->heap.slot = (int*)malloc((n + 1) * sizeof(int));
+        side->heap.key = side->priority;
+        if (!side->dist || !side->prev || !side->priority || !side->stamp || !side->done ||
+            !side->heap.nodes || !side->heap.slot) {
+            free_workspace();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Starts a new query: entries stamped with an older query read as unseen.
+void begin_query() {
+    if (++workspace.query == 0) {
+        for (int s = 0; s < 2; s++) {
+            memset(workspace.sides[s].stamp, 0, road_graph.node_count * sizeof(uint32_t));
+        }
+        workspace.query = 1;
+    }
+    workspace.sides[0].heap.size = 0;
+    workspace.sides[1].heap.size = 0;
+    workspace.settled = 0;
+}
+
+void touch(SearchSide* side, int v) {
+    if (side->stamp[v] != workspace.query) {
+        side->stamp[v] = workspace.query;
+        side->dist[v] = INF;
+        side->prev[v] = -1;
+        side->heap.slot[v] = -1;
+        side->done[v] = 0;
+    }
+}
+
+// ALT lower bound on the travel time from v to `target`: by the triangle
+// inequality, d(v, t) >= d(L, t) - d(L, v) and d(v, t) >= d(v, L) - d(t, L)
+// for every landmark L.
+int landmark_estimate(int v, int target) {
+    int n = (int)road_graph.node_count;
+    int best = 0;
+
+    for (int k = 0; k < workspace.landmark_count; k++) {
+        const int* from = workspace.from_landmark + (size_t)k * n;
+        const int* to = workspace.to_landmark + (size_t)k * n;
+        if (from[v] != INF && from[target] != INF && from[target] - from[v] > best) {
+            best = from[target] - from[v];
+        }
+        if (to[v] != INF && to[target] != INF && to[v] - to[target] > best) {
+            best = to[v] - to[target];
+        }
+    }
+    return best;
+}
+
+// One direction of a search from `source`: side 0 follows roads forward,
+// side 1 backward. Stops once `target` is settled (-1 runs to exhaustion);
+// with `use_estimate` the queue is ordered by distance plus the landmark
+// bound, which makes it A*. Returns the distance to `target`.
+int search(int s, int source, int target, int use_estimate) {
+    SearchSide* side = &workspace.sides[s];
+    const uint32_t* offsets = s ? road_graph.in_offsets : road_graph.out_offsets;
+    const uint32_t* targets = s ? road_graph.in_sources : road_graph.out_targets;
+
+    touch(side, source);
+    side->dist[source] = 0;
+    side->priority[source] = use_estimate ? landmark_estimate(source, target) : 0;
+    heap_push_or_decrease(&side->heap, source);
+
+    while (side->heap.size > 0) {
+        int u = heap_pop(&side->heap);
+        side->done[u] = 1;
+        workspace.settled++;
+        if (u == target) return side->dist[u];
+
+        for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++) {
+            int v = (int)targets[e];
+            int new_dist = side->dist[u] + road_time(e);
+            touch(side, v);
+            if (!side->done[v] && new_dist < side->dist[v]) {
+                side->dist[v] = new_dist;
+                side->prev[v] = u;
+                side->priority[v] = new_dist + (use_estimate ? landmark_estimate(v, target) : 0);
+                heap_push_or_decrease(&side->heap, v);
+            }
+        }
+    }
+    return target == -1 ? 0 : INF;
+}
+
+// Bidirectional Dijkstra: grows a search from each end, always the one
+// with the smaller frontier, and records the best start -> x -> y -> end
+// seen over a road x -> y between the two. Once the two queue minimums add
+// up to at least that, no better route remains. The backward half of the
+// route is then written into the forward prev array.
+int search_bidirectional(int start, int end) {
+    SearchSide* forward = &workspace.sides[0];
+    SearchSide* backward = &workspace.sides[1];
+    long long best = INF;
+    int meet_forward = start, meet_backward = end;
+
+    if (start == end) return 0;
+    touch(forward, start);
+    forward->dist[start] = forward->priority[start] = 0;
+    heap_push_or_decrease(&forward->heap, start);
+    touch(backward, end);
+    backward->dist[end] = backward->priority[end] = 0;
+    heap_push_or_decrease(&backward->heap, end);
+
+    while (forward->heap.size > 0 && backward->heap.size > 0) {
+        long long bound = (long long)forward->dist[forward->heap.nodes[0]] +
+                          backward->dist[backward->heap.nodes[0]];
+        if (bound >= best) break;
+
+        int s = forward->heap.size <= backward->heap.size ? 0 : 1;
+        SearchSide* side = &workspace.sides[s];
+        SearchSide* other = &workspace.sides[1 - s];
+        const uint32_t* offsets = s ? road_graph.in_offsets : road_graph.out_offsets;
+        const uint32_t* targets = s ? road_graph.in_sources : road_graph.out_targets;
+
+        int u = heap_pop(&side->heap);
+        side->done[u] = 1;
+        workspace.settled++;
+        for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++) {
+            int v = (int)targets[e];
+            int new_dist = side->dist[u] + road_time(e);
+            touch(side, v);
+            if (!side->done[v] && new_dist < side->dist[v]) {
+                side->dist[v] = new_dist;
+                side->priority[v] = new_dist;
+                side->prev[v] = u;
+                heap_push_or_decrease(&side->heap, v);
+            }
+            if (other->stamp[v] == workspace.query && other->dist[v] != INF &&
+                (long long)new_dist + other->dist[v] < best) {
+                best = (long long)new_dist + other->dist[v];
+                meet_forward = s ? v : u;
+                meet_backward = s ? u : v;
+            }
+        }
+    }
+
+    if (best >= INF) {
+        touch(forward, end);
+        forward->prev[end] = -1;
+        return INF;
+    }
+    forward->prev[meet_backward] = meet_forward;
+    for (int v = meet_backward; v != end; v = backward->prev[v]) {
+        forward->prev[backward->prev[v]] = v;
+    }
+    return (int)best;
+}
+
+// Picks ALT_LANDMARKS landmarks by farthest-point selection (each one as
+// far as possible from those already chosen) and stores every location's
+// distance from, and for directed graphs to, each of them.
+int prepare_landmarks() {
+    int n = (int)road_graph.node_count;
+    int directed = !(road_graph.flags & GRAPH_UNDIRECTED);
+    int count = n < ALT_LANDMARKS ? n : ALT_LANDMARKS;
+
+    if (workspace.landmarks || count == 0) return 1;
+    workspace.landmarks = (int*)malloc(count * sizeof(int));
+    workspace.from_landmark = (int*)malloc((size_t)count * n * sizeof(int));
+    workspace.to_landmark =
+        directed ? (int*)malloc((size_t)count * n * sizeof(int)) : workspace.from_landmark;
+    int* nearest = (int*)malloc(n * sizeof(int)); // distance to the closest landmark so far
+    if (!workspace.landmarks || !workspace.from_landmark || !workspace.to_landmark || !nearest) {
+        free(nearest);
+        return 0;
+    }
+
+    // Start from whatever lies farthest from location 0.
+    begin_query();
+    search(0, 0, -1, 0);
+    int landmark = 0;
+    for (int v = 0; v < n; v++) {
+        nearest[v] = INF;
+        if (workspace.sides[0].stamp[v] == workspace.query &&
+            workspace.sides[0].dist[v] > workspace.sides[0].dist[landmark]) {
+            landmark = v;
+        }
+    }
+
+    for (int k = 0; k < count; k++) {
+        workspace.landmarks[k] = landmark;
+        for (int s = 0; s < 1 + directed; s++) {
+            int* row = (s ? workspace.to_landmark : workspace.from_landmark) + (size_t)k * n;
+            begin_query();
+            search(s, landmark, -1, 0);
+            for (int v = 0; v < n; v++) {
+                row[v] = workspace.sides[s].stamp[v] == workspace.query ? workspace.sides[s].dist[v]
+                                                                          : INF;
+            }
+        }
+
+        const int* row = workspace.from_landmark + (size_t)k * n;
+        int farthest = -1;
+        for (int v = 0; v < n; v++) {
+            if (row[v] < nearest[v]) nearest[v] = row[v];
+            if (nearest[v] != INF && (farthest == -1 || nearest[v] > nearest[farthest])) {
+                farthest = v;
+            }
+        }
+        landmark = farthest;
+    }
+    workspace.landmark_count = count;
+    free(nearest);
+    return 1;
+}
+
+// Point-to-point route from `start` to `end`. Returns the travel time (INF
+// if there is no route, -1 if out of memory) and points *prev at an array
+// that print_path(*prev, start, end) follows; it stays valid until the
+// next query. ROUTE_FULL runs the complete single-source search with
+// `queue_kind`; the other methods stop as soon as the route is known.
+int find_route(int start, int end, int method, int queue_kind, int** prev) {
+    if (!prepare_workspace()) return -1;
+
+    if (method == ROUTE_FULL) {
+        SearchSide* side = &workspace.sides[0];
+        // Writes every entry; the next query's stamps still tell them apart.
+        begin_query();
+        if (!dijkstra(start, side->dist, side->prev, queue_kind)) return -1;
+        workspace.settled = road_graph.node_count;
+        *prev = side->prev;
+        return side->dist[end];
+    }
+
+    if (method != ROUTE_EARLY_EXIT && !reverse_search_possible()) {
+        method = ROUTE_EARLY_EXIT;
+    }
+    if (method == ROUTE_ASTAR && !prepare_landmarks()) return -1;
+
+    begin_query();
+    int time;
+    if (method == ROUTE_BIDIRECTIONAL) {
+        time = search_bidirectional(start, end);
+    } else {
+        time = search(0, start, end, method == ROUTE_ASTAR);
+        if (time == INF) {
+            touch(&workspace.sides[0], end);
+        }
+    }
+    *prev = workspace.sides[0].prev;
+    return time;
 }
 
 void print_path(int prev[], int start, int end) {
     if (end == start) {
-        printf("%s", locations[start]);
+        printf("%s", location_name(start));
         return;
     }
-    
+
     if (prev[end] == -1) {
         printf("No path found");
         return;
     }
-    
+
     print_path(prev, start, prev[end]);
-    printf(" -> %s", locations[end]);
+    printf(" -> %s", location_name(end));
+}
+
+int initialize_graph() {
+    const char* names[] = {"Dispatch Center", "Sector A", "Sector B", "Sector D",
+                           "Emergency Site", "Junction C", "Sector E"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (add_location(names[i]) == -1) return 0;
+    }
+
+    int ok = add_road("Dispatch Center", "Sector A", 10) &&
+             add_road("Dispatch Center", "Sector D", 30) &&
+             add_road("Sector A", "Sector B", 10) &&
+             add_road("Sector B", "Emergency Site", 15) &&
+             add_road("Sector D", "Emergency Site", 5) &&
+             add_road("Sector B", "Junction C", 3) &&
+             add_road("Junction C", "Sector E", 6) &&
+             add_road("Sector E", "Emergency Site", 4);
+    return ok && build_road_graph();
+}
+
+double elapsed_ms(const struct timespec* begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+// Converts a road list to a graph snapshot.
+int compile_roads(const char* roads_path, const char* out_path) {
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (!load_roads(roads_path) || !build_road_graph()) {
+        return 0;
+    }
+
+    int ok = graph_snapshot_write(&road_graph, out_path);
+    if (ok) {
+        struct stat info;
+        double megabytes = stat(out_path, &info) == 0 ? info.st_size / (1024.0 * 1024.0) : 0;
+        printf("Compiled %u locations and %u road directions into %s (%.1f MB) in %.1f ms\n",
+               road_graph.node_count, road_graph.edge_count, out_path, megabytes,
+               elapsed_ms(&begin));
+    } else {
+        printf("Error: Could not write %s\n", out_path);
+    }
+    free_road_graph();
+    return ok;
+}
+
+uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// A grid city of side x side intersections. Each street to the east and
+// south neighbor is open with probability 9/10 and takes 1 to
+// BENCH_MAX_MINUTES minutes.
+int generate_city(int side, uint64_t* state) {
+    char from[MAX_LINE], to[MAX_LINE];
+
+    for (int i = 0; i < side * side; i++) {
+        snprintf(from, sizeof(from), "I%d", i);
+        if (add_location(from) == -1) return 0;
+    }
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            snprintf(from, sizeof(from), "I%d", r * side + c);
+            for (int direction = 0; direction < 2; direction++) {
+                int nr = r + direction, nc = c + 1 - direction;
+                if (nr == side || nc == side || next_random(state) % 10 == 0) continue;
+                snprintf(to, sizeof(to), "I%d", nr * side + nc);
+                int minutes = 1 + (int)(next_random(state) % BENCH_MAX_MINUTES);
+                if (!add_road(from, to, minutes)) return 0;
+            }
+        }
+    }
+    return build_road_graph();
+}
+
+// Times single-source searches with each queue on grid cities from
+// BENCH_MIN_NODES intersections up to `max_nodes`, checking that every
+// queue finds the same distances.
+void run_benchmark(int max_nodes) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    const char* names[3] = {"heap", "dial", "linear"};
+
+    printf("%10s %10s %12s %12s %12s %10s\n", "Nodes", "Roads", "Linear ms", "Heap ms",
+           "Dial ms", "Speedup");
+    for (long nodes = BENCH_MIN_NODES; nodes <= max_nodes; nodes *= 10) {
+        int side = 1;
+        while ((long)(side + 1) * (side + 1) <= nodes) side++;
+        if (!generate_city(side, &state)) {
+            printf("Error: Out of memory\n");
+            free_road_graph();
+            return;
+        }
+
+        int n = (int)road_graph.node_count;
+        int* dist = (int*)malloc((n + 1) * sizeof(int));
+        int* prev = (int*)malloc((n + 1) * sizeof(int));
+        int* expected = (int*)malloc((n + 1) * sizeof(int));
+        if (!dist || !prev || !expected) {
+            printf("Error: Out of memory\n");
+            free(dist);
+            free(prev);
+            free(expected);
+            free_road_graph();
+            return;
+        }
+
+        double total_ms[3] = {0};
+        int runs[3] = {0};
+        int mismatch = 0;
+        for (int q = 0; q < BENCH_SOURCES; q++) {
+            int start = (int)(next_random(&state) % n);
+            for (int kind = QUEUE_HEAP; kind <= QUEUE_LINEAR; kind++) {
+                // The quadratic scan gets a single source on large cities.
+                if (kind == QUEUE_LINEAR && (n > BENCH_LINEAR_MAX_NODES ||
+                                             (q > 0 && n * 10L > BENCH_LINEAR_MAX_NODES))) {
+                    continue;
+                }
+                struct timespec begin;
+                clock_gettime(CLOCK_MONOTONIC, &begin);
+                int ok = dijkstra(start, kind == QUEUE_HEAP ? expected : dist, prev, kind);
+                total_ms[kind] += elapsed_ms(&begin);
+                runs[kind]++;
+                if (!ok) {
+                    printf("Error: Out of memory in %s search\n", names[kind]);
+                    mismatch = 1;
+                } else if (kind != QUEUE_HEAP) {
+                    mismatch |= memcmp(dist, expected, n * sizeof(int)) != 0;
+                }
+            }
+        }
+
+        double per_query[3];
+        for (int kind = 0; kind < 3; kind++) {
+            per_query[kind] = runs[kind] ? total_ms[kind] / runs[kind] : 0;
+        }
+        char linear[32];
+        char speedup[32];
+        if (runs[QUEUE_LINEAR]) {
+            snprintf(linear, sizeof(linear), "%.1f", per_query[QUEUE_LINEAR]);
+            snprintf(speedup, sizeof(speedup), "%.0fx", per_query[QUEUE_LINEAR] /
+                     (per_query[QUEUE_DIAL] > 0 ? per_query[QUEUE_DIAL] : 1e-3));
+        } else {
+            snprintf(linear, sizeof(linear), "-");
+            snprintf(speedup, sizeof(speedup), "-");
+        }
+        printf("%10d %10u %12s %12.2f %12.2f %10s%s\n", n, road_graph.edge_count / 2, linear,
+               per_query[QUEUE_HEAP], per_query[QUEUE_DIAL], speedup,
+               mismatch ? "  MISMATCH" : "");
+        fflush(stdout);
+
+        free(dist);
+        free(prev);
+        free(expected);
+        free_road_graph();
+    }
 }
 
-void initialize_graph() {
-    for (int i = 0; i < MAX_NODES; i++) {
-        for (int j = 0; j < MAX_NODES; j++) {
-            adj_matrix[i][j] = 0;
+// Travel time along the route recorded in `prev`, -1 if it is broken.
+int route_length(int* prev, int start, int end) {
+    int total = 0;
+    for (int v = end; v != start; v = prev[v]) {
+        int u = prev[v];
+        if (u == -1) return -1;
+        int step = -1;
+        for (uint32_t e = road_graph.out_offsets[u]; e < road_graph.out_offsets[u + 1]; e++) {
+            if ((int)road_graph.out_targets[e] == v && (step == -1 || road_time(e) < step)) {
+                step = road_time(e);
+            }
         }
+        if (step == -1) return -1;
+        total += step;
     }
-    
-    add_road("Dispatch Center", "Sector A", 10);
-    add_road("Dispatch Center", "Sector D", 30);
-    add_road("Sector A", "Sector B", 10);
-    add_road("Sector B", "Emergency Site", 15);
-    add_road("Sector D", "Emergency Site", 5);
-    add_road("Sector B", "Junction C", 3);
-    add_road("Junction C", "Sector E", 6);
-    add_road("Sector E", "Emergency Site", 4);
+    return total;
 }
 
-int main() {
+// Random start/end pairs on grid cities from BENCH_MIN_NODES
+// intersections up to `max_nodes`: per-query latency and share of the city
+// settled by each point-to-point method, checked against the full search.
+void run_route_benchmark(int max_nodes) {
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    const char* names[4] = {"full", "early exit", "bidirectional", "A* (ALT)"};
+
+    printf("%10s %14s %12s %12s %10s\n", "Nodes", "Method", "us/query", "Settled", "Speedup");
+    for (long nodes = BENCH_MIN_NODES; nodes <= max_nodes; nodes *= 10) {
+        int side = 1;
+        while ((long)(side + 1) * (side + 1) <= nodes) side++;
+        if (!generate_city(side, &state)) {
+            printf("Error: Out of memory\n");
+            free_road_graph();
+            return;
+        }
+
+        int n = (int)road_graph.node_count;
+        int starts[BENCH_ROUTES], ends[BENCH_ROUTES], expected[BENCH_ROUTES];
+        for (int q = 0; q < BENCH_ROUTES; q++) {
+            starts[q] = (int)(next_random(&state) % n);
+            ends[q] = (int)(next_random(&state) % n);
+        }
+
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (!prepare_workspace() || !prepare_landmarks()) {
+            printf("Error: Out of memory\n");
+            free_road_graph();
+            return;
+        }
+        double landmark_ms = elapsed_ms(&begin);
+
+        double full_us = 0;
+        for (int method = ROUTE_FULL; method <= ROUTE_ASTAR; method++) {
+            double total_ms = 0;
+            long settled = 0;
+            int mismatch = 0;
+            for (int q = 0; q < BENCH_ROUTES; q++) {
+                int* prev;
+                clock_gettime(CLOCK_MONOTONIC, &begin);
+                int time = find_route(starts[q], ends[q], method, QUEUE_HEAP, &prev);
+                total_ms += elapsed_ms(&begin);
+                settled += workspace.settled;
+                if (method == ROUTE_FULL) {
+                    expected[q] = time;
+                    continue;
+                }
+                // The route must also add up to the reported time.
+                mismatch |= time != INF && route_length(prev, starts[q], ends[q]) != time;
+                mismatch |= time != expected[q];
+            }
+            double us = total_ms * 1e3 / BENCH_ROUTES;
+            if (method == ROUTE_FULL) full_us = us;
+            printf("%10d %14s %12.1f %11.1f%% %9.1fx%s\n", n, names[method], us,
+                   100.0 * settled / ((double)n * BENCH_ROUTES), full_us / (us > 0 ? us : 1e-3),
+                   mismatch ? "  MISMATCH" : "");
+        }
+        printf("%10s %14s %12.1f ms to pick %d landmarks\n", "", "", landmark_ms,
+               workspace.landmark_count);
+        fflush(stdout);
+        free_road_graph();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* roads_path = NULL;
+    const char* graph_path = NULL;
+    const char* compile_path = NULL;
+    int queue_kind = QUEUE_HEAP;
+    int method = ROUTE_BIDIRECTIONAL;
+    int bench_nodes = 0;
+    int bench_routes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            roads_path = argv[++i];
+        } else if (strcmp(argv[i], "--graph") == 0 && i + 1 < argc) {
+            graph_path = argv[++i];
+        } else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+            roads_path = argv[++i];
+            compile_path =
+                (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : DEFAULT_GRAPH_FILE;
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "heap") == 0 || strcmp(argv[i + 1], "dial") == 0 ||
+                    strcmp(argv[i + 1], "linear") == 0)) {
+            i++;
+            queue_kind = strcmp(argv[i], "heap") == 0   ? QUEUE_HEAP
+                         : strcmp(argv[i], "dial") == 0 ? QUEUE_DIAL
+                                                        : QUEUE_LINEAR;
+        } else if (strcmp(argv[i], "--method") == 0 && i + 1 < argc) {
+            const char* methods[4] = {"full", "early", "bidirectional", "astar"};
+            method = -1;
+            for (int m = 0; m < 4; m++) {
+                if (strcmp(argv[i + 1], methods[m]) == 0) method = m;
+            }
+            if (method == -1) {
+                printf("Error: Unknown method '%s'\n", argv[i + 1]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--bench-routes") == 0) {
+            bench_routes = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i])
+                                                                    : DEFAULT_BENCH_MAX_NODES;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench_nodes = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i])
+                                                                   : DEFAULT_BENCH_MAX_NODES;
+        } else {
+            printf("Usage: %s [--load ROADS | --graph SNAPSHOT]\n"
+                   "         [--method full|early|bidirectional|astar] [--queue heap|dial|linear]\n"
+                   "       %s --compile ROADS [SNAPSHOT]\n"
+                   "       %s --bench [MAX_NODES] | --bench-routes [MAX_NODES]\n",
+                   argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (compile_path) {
+        return compile_roads(roads_path, compile_path) ? 0 : 1;
+    }
+    if (bench_nodes > 0) {
+        run_benchmark(bench_nodes);
+        return 0;
+    }
+    if (bench_routes > 0) {
+        run_route_benchmark(bench_routes);
+        return 0;
+    }
+
     printf("Emergency Route Optimization\n");
-    
-    initialize_graph();
-    
-    char start_location[50];
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int loaded;
+    if (graph_path) {
+        loaded = graph_snapshot_open(graph_path, &road_graph, stdout);
+        // Unweighted links count one minute each, so a route is at most
+        // one minute per location.
+        if (loaded && !road_graph.weights && road_graph.node_count > GRAPH_MAX_TOTAL_WEIGHT) {
+            printf("Error: %s has too many locations to route over\n", graph_path);
+            loaded = 0;
+        }
+    } else if (roads_path) {
+        loaded = load_roads(roads_path) && build_road_graph();
+    } else {
+        loaded = initialize_graph();
+    }
+    if (!loaded) {
+        free_road_graph();
+        return 1;
+    }
+    if (graph_path || roads_path) {
+        printf("%s %u locations from %s in %.1f ms\n", graph_path ? "Mapped" : "Loaded",
+               road_graph.node_count, graph_path ? graph_path : roads_path, elapsed_ms(&begin));
+    }
+
+    char start_location[MAX_LINE];
     printf("\nEnter starting location: ");
     fflush(stdout);
-    fgets(start_location, sizeof(start_location), stdin);
+    if (!fgets(start_location, sizeof(start_location), stdin)) {
+        start_location[0] = '\0';
+    }
     start_location[strcspn(start_location, "\n")] = 0;
-    
+
     int start_idx = find_location_index(start_location);
-    int end_idx = find_location_index("Emergency Site");
-    
-    if (start_idx == -1) {
-        printf("Location not found\n");
+    int end_idx = find_location_index(DESTINATION);
+
+    if (start_idx == -1 || end_idx == -1) {
+        printf("%s not found\n", start_idx == -1 ? "Location" : "Destination '" DESTINATION "'");
+        free_road_graph();
+        return 1;
+    }
+
+    int* prev;
+    struct timespec query_begin;
+    clock_gettime(CLOCK_MONOTONIC, &query_begin);
+    int time = find_route(start_idx, end_idx, method, queue_kind, &prev);
+    double query_ms = elapsed_ms(&query_begin);
+    if (time == -1) {
+        printf("Error: Out of memory\n");
+        free_road_graph();
         return 1;
     }
-    
-    int dist[MAX_NODES], prev[MAX_NODES];
-    dijkstra(start_idx, dist, prev);
-    
+
     printf("\nOptimal route: ");
     print_path(prev, start_idx, end_idx);
-    printf("\nTotal travel time: %d minutes\n", dist[end_idx]);
-    
+    printf("\nTotal travel time: %d minutes\n", time);
+    printf("Computed in %.3f ms, %ld of %u locations settled\n", query_ms, workspace.settled,
+           road_graph.node_count);
+
+    free_road_graph();
     return 0;
-}
\ No newline at end of file
+}
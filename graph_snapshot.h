@@ -0,0 +1,408 @@
+#ifndef GRAPH_SNAPSHOT_H
+#define GRAPH_SNAPSHOT_H
+
+// Binary graph format shared by 3_device_communication and
+// 4_emergency_route (--compile writes it, --graph maps it). A header is
+// followed by 64-byte-aligned sections in native byte order:
+//
+//   names         node names, NUL-terminated, back to back
+//   name_offsets  node i's name is at names + name_offsets[i]
+//   name_table    open-addressing hash of the names (FNV-1a, linear
+//                 probing), node + 1 per bucket, 0 = empty
+//   out_offsets   CSR: node i's links are out_targets[out_offsets[i] ..
+//   out_targets   out_offsets[i + 1]), sorted by target
+//   weights       one per out_targets entry (GRAPH_WEIGHTED only)
+//   in_offsets    the same links reversed (directed graphs only; an
+//   in_sources    undirected graph stores each link in both rows)
+//
+// Everything refers to other data by node number or offset, so a mapping
+// is queried in place: opening checks the header, the section bounds and
+// every stored number in one pass, and processes mapping the same file
+// share one copy in the page cache.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GRAPH_SNAPSHOT_MAGIC 0x48505247u // "GRPH"
+#define GRAPH_SNAPSHOT_VERSION 1
+#define GRAPH_SNAPSHOT_ALIGN 64
+#define GRAPH_WEIGHTED 1u
+#define GRAPH_UNDIRECTED 2u
+// Weights over all links add up to at most this. No simple path is longer
+// than the total, so readers can add path lengths, even two of them, in int.
+#define GRAPH_MAX_TOTAL_WEIGHT (INT_MAX / 4)
+
+enum {
+  GRAPH_SECTION_NAMES,
+  GRAPH_SECTION_NAME_OFFSETS,
+  GRAPH_SECTION_NAME_TABLE,
+  GRAPH_SECTION_OUT_OFFSETS,
+  GRAPH_SECTION_OUT_TARGETS,
+  GRAPH_SECTION_WEIGHTS,
+  GRAPH_SECTION_IN_OFFSETS,
+  GRAPH_SECTION_IN_SOURCES,
+  GRAPH_SECTION_COUNT
+};
+
+typedef struct {
+  uint64_t offset; // from the start of the file
+  uint64_t size;
+} GraphSection;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t node_count;
+  uint32_t edge_count; // entries in out_targets
+  uint32_t name_table_mask;
+  uint32_t checksum; // CRC-32 of the header with this field zero
+  uint32_t reserved;
+  GraphSection sections[GRAPH_SECTION_COUNT];
+} GraphSnapshotHeader;
+
+// A graph in snapshot layout: either pointing into a mapped file or at
+// arrays a tool built itself and wants to write out. For an undirected
+// graph in_offsets/in_sources alias the out arrays; weights is NULL when
+// the graph is unweighted.
+typedef struct {
+  uint32_t flags;
+  uint32_t node_count;
+  uint32_t edge_count;
+  const char *names;
+  size_t names_size;
+  const uint32_t *name_offsets;
+  const uint32_t *name_table;
+  uint32_t name_table_mask;
+  const uint32_t *out_offsets;
+  const uint32_t *out_targets;
+  const uint32_t *weights;
+  const uint32_t *in_offsets;
+  const uint32_t *in_sources;
+  void *mapping; // NULL unless opened from a file
+  size_t mapping_size;
+} GraphSnapshot;
+
+static inline uint32_t graph_hash_name(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+    hash = (hash ^ *p) * 16777619u;
+  }
+  return hash;
+}
+
+// CRC-32 (bitwise; it only ever covers a header).
+static inline uint32_t graph_header_crc(const GraphSnapshotHeader *header) {
+  GraphSnapshotHeader copy = *header;
+  const unsigned char *bytes = (const unsigned char *)&copy;
+  uint32_t crc = 0xFFFFFFFFu;
+
+  copy.checksum = 0;
+  for (size_t i = 0; i < sizeof(copy); i++) {
+    crc ^= bytes[i];
+    for (int k = 0; k < 8; k++) {
+      crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Node number of `name`, or -1.
+static inline int graph_find_node(const GraphSnapshot *graph, const char *name) {
+  if (!graph->name_table) {
+    return -1;
+  }
+
+  uint32_t bucket = graph_hash_name(name) & graph->name_table_mask;
+  while (graph->name_table[bucket]) {
+    uint32_t node = graph->name_table[bucket] - 1;
+    if (strcmp(graph->names + graph->name_offsets[node], name) == 0) {
+      return (int)node;
+    }
+    bucket = (bucket + 1) & graph->name_table_mask;
+  }
+  return -1;
+}
+
+// Hash table for `count` names, kept at most half full; sets `mask`.
+// NULL if out of memory.
+static inline uint32_t *graph_build_name_table(const char *names, const uint32_t *name_offsets,
+                                               uint32_t count, uint32_t *mask) {
+  uint64_t size = 2;
+  while (size < 2 * (uint64_t)count) {
+    size *= 2;
+  }
+  uint32_t *table = (uint32_t *)calloc(size, sizeof(uint32_t));
+  if (!table) {
+    return NULL;
+  }
+
+  *mask = (uint32_t)(size - 1);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t bucket = graph_hash_name(names + name_offsets[i]) & *mask;
+    while (table[bucket]) {
+      bucket = (bucket + 1) & *mask;
+    }
+    table[bucket] = i + 1;
+  }
+  return table;
+}
+
+// Writes `graph` as a snapshot, building its name table if it has none.
+// Sections are streamed to a temporary file that is renamed over `path`,
+// so a reader never maps a partial file.
+static inline int graph_snapshot_write(const GraphSnapshot *graph, const char *path) {
+  GraphSnapshotHeader header;
+  const void *data[GRAPH_SECTION_COUNT];
+  uint64_t n = graph->node_count;
+  uint64_t m = graph->edge_count;
+  int directed = !(graph->flags & GRAPH_UNDIRECTED);
+  int weighted = (graph->flags & GRAPH_WEIGHTED) != 0;
+  uint32_t *built_table = NULL;
+  uint32_t mask = graph->name_table_mask;
+
+  const uint32_t *name_table = graph->name_table;
+  if (!name_table) {
+    built_table = graph_build_name_table(graph->names, graph->name_offsets, graph->node_count,
+                                         &mask);
+    if (!built_table) {
+      return 0;
+    }
+    name_table = built_table;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.magic = GRAPH_SNAPSHOT_MAGIC;
+  header.version = GRAPH_SNAPSHOT_VERSION;
+  header.flags = graph->flags;
+  header.node_count = graph->node_count;
+  header.edge_count = graph->edge_count;
+  header.name_table_mask = mask;
+
+  data[GRAPH_SECTION_NAMES] = graph->names;
+  header.sections[GRAPH_SECTION_NAMES].size = graph->names_size;
+  data[GRAPH_SECTION_NAME_OFFSETS] = graph->name_offsets;
+  header.sections[GRAPH_SECTION_NAME_OFFSETS].size = n * sizeof(uint32_t);
+  data[GRAPH_SECTION_NAME_TABLE] = name_table;
+  header.sections[GRAPH_SECTION_NAME_TABLE].size = ((uint64_t)mask + 1) * sizeof(uint32_t);
+  data[GRAPH_SECTION_OUT_OFFSETS] = graph->out_offsets;
+  header.sections[GRAPH_SECTION_OUT_OFFSETS].size = (n + 1) * sizeof(uint32_t);
+  data[GRAPH_SECTION_OUT_TARGETS] = graph->out_targets;
+  header.sections[GRAPH_SECTION_OUT_TARGETS].size = m * sizeof(uint32_t);
+  data[GRAPH_SECTION_WEIGHTS] = graph->weights;
+  header.sections[GRAPH_SECTION_WEIGHTS].size = weighted ? m * sizeof(uint32_t) : 0;
+  data[GRAPH_SECTION_IN_OFFSETS] = graph->in_offsets;
+  header.sections[GRAPH_SECTION_IN_OFFSETS].size = directed ? (n + 1) * sizeof(uint32_t) : 0;
+  data[GRAPH_SECTION_IN_SOURCES] = graph->in_sources;
+  header.sections[GRAPH_SECTION_IN_SOURCES].size = directed ? m * sizeof(uint32_t) : 0;
+
+  uint64_t total = sizeof(GraphSnapshotHeader);
+  for (int i = 0; i < GRAPH_SECTION_COUNT; i++) {
+    total = (total + GRAPH_SNAPSHOT_ALIGN - 1) & ~(uint64_t)(GRAPH_SNAPSHOT_ALIGN - 1);
+    header.sections[i].offset = total;
+    total += header.sections[i].size;
+  }
+  header.checksum = graph_header_crc(&header);
+
+  char temp_path[PATH_MAX];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+  FILE *file = fopen(temp_path, "wb");
+  int ok = file != NULL;
+  if (ok) {
+    static const char padding[GRAPH_SNAPSHOT_ALIGN];
+    uint64_t written = sizeof(header);
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < GRAPH_SECTION_COUNT; i++) {
+      uint64_t gap = header.sections[i].offset - written;
+      ok = fwrite(padding, 1, gap, file) == gap;
+      if (ok && header.sections[i].size > 0) {
+        ok = fwrite(data[i], 1, header.sections[i].size, file) == header.sections[i].size;
+      }
+      written = header.sections[i].offset + header.sections[i].size;
+    }
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temp_path, path) == 0;
+    if (!ok) {
+      unlink(temp_path);
+    }
+  }
+  free(built_table);
+  return ok;
+}
+
+// Checks that a CSR row array and its targets only point inside the graph:
+// offsets start at 0, never decrease and end at `m`, each row is sorted, and
+// every target is below `n`.
+static inline int graph_rows_valid(const uint32_t *offsets, const uint32_t *targets, uint64_t n,
+                                   uint64_t m) {
+  if (offsets[0] != 0 || offsets[n] != m) {
+    return 0;
+  }
+  for (uint64_t i = 0; i < n; i++) {
+    if (offsets[i + 1] < offsets[i] || offsets[i + 1] > m) {
+      return 0;
+    }
+    for (uint32_t e = offsets[i]; e < offsets[i + 1]; e++) {
+      if (targets[e] >= n || (e > offsets[i] && targets[e] < targets[e - 1])) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Checks the contents of a snapshot whose sections are already known to be
+// in bounds, so that no query can read outside the mapping or probe the
+// name table forever. O(n + m + names).
+static inline int graph_contents_valid(const unsigned char *base,
+                                       const GraphSnapshotHeader *header) {
+  const GraphSection *sections = header->sections;
+  uint64_t n = header->node_count;
+  uint64_t m = header->edge_count;
+  uint64_t names_size = sections[GRAPH_SECTION_NAMES].size;
+  const uint32_t *name_offsets =
+      (const uint32_t *)(base + sections[GRAPH_SECTION_NAME_OFFSETS].offset);
+  const uint32_t *name_table = (const uint32_t *)(base + sections[GRAPH_SECTION_NAME_TABLE].offset);
+  int empty_bucket = 0;
+
+  if (n > 0 && (names_size == 0 || base[sections[GRAPH_SECTION_NAMES].offset + names_size - 1])) {
+    return 0;
+  }
+  for (uint64_t i = 0; i < n; i++) {
+    if (name_offsets[i] >= names_size) {
+      return 0;
+    }
+  }
+  for (uint64_t b = 0; b <= header->name_table_mask; b++) {
+    if (name_table[b] > n) {
+      return 0;
+    }
+    empty_bucket |= name_table[b] == 0;
+  }
+  if (!empty_bucket ||
+      !graph_rows_valid((const uint32_t *)(base + sections[GRAPH_SECTION_OUT_OFFSETS].offset),
+                        (const uint32_t *)(base + sections[GRAPH_SECTION_OUT_TARGETS].offset), n,
+                        m)) {
+    return 0;
+  }
+  if (!(header->flags & GRAPH_UNDIRECTED) &&
+      !graph_rows_valid((const uint32_t *)(base + sections[GRAPH_SECTION_IN_OFFSETS].offset),
+                        (const uint32_t *)(base + sections[GRAPH_SECTION_IN_SOURCES].offset), n,
+                        m)) {
+    return 0;
+  }
+  if (header->flags & GRAPH_WEIGHTED) {
+    const uint32_t *weights = (const uint32_t *)(base + sections[GRAPH_SECTION_WEIGHTS].offset);
+    uint64_t total = 0;
+    for (uint64_t e = 0; e < m; e++) {
+      total += weights[e];
+    }
+    if (total > GRAPH_MAX_TOTAL_WEIGHT) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Maps a snapshot read-only and points `graph` at its sections. The
+// header is checked first and then the contents in one O(n + m) pass, so a
+// damaged file is refused here rather than crashing a later query.
+// Returns 0 (after reporting why) if the file is missing or malformed.
+static inline int graph_snapshot_open(const char *path, GraphSnapshot *graph, FILE *report) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat info;
+
+  memset(graph, 0, sizeof(*graph));
+  if (fd < 0) {
+    fprintf(report, "Error: Could not open %s\n", path);
+    return 0;
+  }
+  if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(GraphSnapshotHeader)) {
+    fprintf(report, "Error: %s is truncated\n", path);
+    close(fd);
+    return 0;
+  }
+
+  size_t size = (size_t)info.st_size;
+  unsigned char *base = (unsigned char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(report, "Error: Could not map %s\n", path);
+    return 0;
+  }
+
+  const GraphSnapshotHeader *header = (const GraphSnapshotHeader *)base;
+  const GraphSection *sections = header->sections;
+  uint64_t n = header->node_count;
+  uint64_t m = header->edge_count;
+  int directed = !(header->flags & GRAPH_UNDIRECTED);
+  int weighted = (header->flags & GRAPH_WEIGHTED) != 0;
+  uint64_t expected[GRAPH_SECTION_COUNT] = {
+      sections[GRAPH_SECTION_NAMES].size,
+      n * sizeof(uint32_t),
+      ((uint64_t)header->name_table_mask + 1) * sizeof(uint32_t),
+      (n + 1) * sizeof(uint32_t),
+      m * sizeof(uint32_t),
+      weighted ? m * sizeof(uint32_t) : 0,
+      directed ? (n + 1) * sizeof(uint32_t) : 0,
+      directed ? m * sizeof(uint32_t) : 0};
+  int valid = header->magic == GRAPH_SNAPSHOT_MAGIC &&
+              header->version == GRAPH_SNAPSHOT_VERSION &&
+              header->checksum == graph_header_crc(header) && n <= INT_MAX &&
+              ((uint64_t)header->name_table_mask & (header->name_table_mask + 1ULL)) == 0 &&
+              (uint64_t)header->name_table_mask + 1 > n;
+  for (int i = 0; valid && i < GRAPH_SECTION_COUNT; i++) {
+    valid = sections[i].offset % GRAPH_SNAPSHOT_ALIGN == 0 && sections[i].offset <= size &&
+            sections[i].size <= size - sections[i].offset && sections[i].size == expected[i];
+  }
+  if (!valid) {
+    fprintf(report, "Error: %s is not a graph snapshot or is from another version\n", path);
+    munmap(base, size);
+    return 0;
+  }
+  if (!graph_contents_valid(base, header)) {
+    fprintf(report, "Error: %s is damaged\n", path);
+    munmap(base, size);
+    return 0;
+  }
+
+  graph->flags = header->flags;
+  graph->node_count = header->node_count;
+  graph->edge_count = header->edge_count;
+  graph->names = (const char *)(base + sections[GRAPH_SECTION_NAMES].offset);
+  graph->names_size = sections[GRAPH_SECTION_NAMES].size;
+  graph->name_offsets = (const uint32_t *)(base + sections[GRAPH_SECTION_NAME_OFFSETS].offset);
+  graph->name_table = (const uint32_t *)(base + sections[GRAPH_SECTION_NAME_TABLE].offset);
+  graph->name_table_mask = header->name_table_mask;
+  graph->out_offsets = (const uint32_t *)(base + sections[GRAPH_SECTION_OUT_OFFSETS].offset);
+  graph->out_targets = (const uint32_t *)(base + sections[GRAPH_SECTION_OUT_TARGETS].offset);
+  graph->weights =
+      weighted ? (const uint32_t *)(base + sections[GRAPH_SECTION_WEIGHTS].offset) : NULL;
+  if (directed) {
+    graph->in_offsets = (const uint32_t *)(base + sections[GRAPH_SECTION_IN_OFFSETS].offset);
+    graph->in_sources = (const uint32_t *)(base + sections[GRAPH_SECTION_IN_SOURCES].offset);
+  } else {
+    graph->in_offsets = graph->out_offsets;
+    graph->in_sources = graph->out_targets;
+  }
+  graph->mapping = base;
+  graph->mapping_size = size;
+  return 1;
+}
+
+static inline void graph_snapshot_close(GraphSnapshot *graph) {
+  if (graph->mapping) {
+    munmap(graph->mapping, graph->mapping_size);
+  }
+  memset(graph, 0, sizeof(*graph));
+}
+
+#endif